@@ -8,15 +8,26 @@ If used, modified, or distributed, please aknowledge the author of this code.
 
 #include "GFW.h"
 GFW::GFW():
-  fInitialized(false)
+  fInitialized(false),
+  fUseKernels(true),
+  fUseSparseTerms(true),
+  fPoolMinBins(0),
+  fPlanEvaluated(false),
+  fMissingTermsReported(false),
+  fNOutputs(0),
+  fNBins(1),
+  fNEtaSlices(0),
+  fSliceEtaMin(0),
+  fSliceEtaMax(0),
+  fSlicesFinalized(true),
+  fSegmentsFlushed(true),
+  fLayout(0)
 {
 };
 
 GFW::~GFW() {
-  for(auto pItr = fCumulants.begin(); pItr != fCumulants.end(); ++pItr)
-    pItr->DestroyComplexVectorArray();
 };
-void GFW::AddRegion(string refName, double lEtaMin, double lEtaMax, int lNpT, int BitMask) {
+void GFW::AddRegion(string refName, double lEtaMin, double lEtaMax, int lNpT, int BitMask, int precision) {
   if(lNpT < 1) {
     printf("Number of pT bins cannot be less than 1! Not adding anything.\n");
     return;
@@ -29,6 +40,10 @@ void GFW::AddRegion(string refName, double lEtaMin, double lEtaMax, int lNpT, in
     printf("Region must have a name!\n");
     return;
   };
+  if(lNpT>1 && !fAxes.empty()) {
+    printf("Axes are defined, so tracks are filled with a bin index of all axes rather than the pT bin. Region %s has to be binned with axes! Not adding...\n",refName.c_str());
+    return;
+  };
   Region lOneRegion;
   lOneRegion.Nhar = 0; //Empty for now
   lOneRegion.powsDefined = false; //If vector with powers defined, set this to zero
@@ -38,50 +53,598 @@ void GFW::AddRegion(string refName, double lEtaMin, double lEtaMax, int lNpT, in
   lOneRegion.NpT = lNpT; //Number of pT bins
   lOneRegion.rName = refName; //Name of the region
   lOneRegion.BitMask = BitMask; //Bit mask
+  lOneRegion.precision = precision; //Storage precision
   AddRegion(lOneRegion);
 };
-void GFW::AddRegion(string refName, vector<int> lNparVec, double lEtaMin, double lEtaMax, int lNpT, int BitMask) {
-  AddRegion(refName,lEtaMin,lEtaMax,lNpT,BitMask);
+void GFW::AddRegion(string refName, vector<int> lNparVec, double lEtaMin, double lEtaMax, int lNpT, int BitMask, int precision) {
+  AddRegion(refName,lEtaMin,lEtaMax,lNpT,BitMask,precision);
   (fRegions.end()-1)->Nhar = (int)lNparVec.size();
   (fRegions.end()-1)->NparVec = lNparVec;
   (fRegions.end()-1)->powsDefined = true;
 };
-void GFW::AddRegion(string refName, int lNhar, int lNpar, double lEtaMin, double lEtaMax, int lNpT, int BitMask) {
+void GFW::AddRegion(string refName, int lNhar, int lNpar, double lEtaMin, double lEtaMax, int lNpT, int BitMask, int precision) {
   vector<int> tVec={};
   for(int i=0;i<lNhar;i++) tVec.push_back(lNpar);
-  AddRegion(refName,tVec,lEtaMin,lEtaMax,lNpT,BitMask);
+  AddRegion(refName,tVec,lEtaMin,lEtaMax,lNpT,BitMask,precision);
 };
-void GFW::AddRegion(string refName, int lNhar, int *lNparVec, double lEtaMin, double lEtaMax, int lNpT, int BitMask) {
+void GFW::AddRegion(string refName, int lNhar, int *lNparVec, double lEtaMin, double lEtaMax, int lNpT, int BitMask, int precision) {
   vector<int> tVec={};
   for(int i=0;i<lNhar;i++) tVec.push_back(lNparVec[i]);
-  AddRegion(refName,tVec,lEtaMin,lEtaMax,lNpT,BitMask);
+  AddRegion(refName,tVec,lEtaMin,lEtaMax,lNpT,BitMask,precision);
+};
+int GFW::AddAxis(string axisName, int nBins) {
+  if(nBins<1) { printf("Axis must have at least one bin! Not adding anything.\n"); return -1; };
+  if(FindAxisByName(axisName)>-1) { printf("Axis %s already exists!\n",axisName.c_str()); return -1; };
+  for(auto &reg: fRegions) if(reg.Axes.empty() && reg.NpT>1) { printf("Region %s is binned in pT without axes, so axes cannot be added! Not adding axis %s.\n",reg.rName.c_str(),axisName.c_str()); return -1; };
+  Axis lAxis = {axisName, nBins, fNBins};
+  fAxes.push_back(lAxis);
+  fNBins*=nBins;
+  return (int)fAxes.size()-1;
+};
+int GFW::FindAxisByName(string axisName) {
+  for(int i=0;i<(int)fAxes.size();i++) if(fAxes[i].Name==axisName) return i;
+  return -1;
+};
+void GFW::AddRegion(string refName, double lEtaMin, double lEtaMax, vector<string> lAxes, int BitMask, int precision) {
+  vector<int> lAxisInd;
+  int lNBins=1;
+  for(auto &axisName: lAxes) {
+    int ind = FindAxisByName(axisName);
+    if(ind<0) { printf("Could not find axis named %s! Not adding region %s.\n",axisName.c_str(),refName.c_str()); return; };
+    lAxisInd.push_back(ind);
+    lNBins*=fAxes[ind].NBins;
+  };
+  int nBefore = (int)fRegions.size();
+  AddRegion(refName,lEtaMin,lEtaMax,1,BitMask,precision);
+  if((int)fRegions.size()==nBefore) return;
+  fRegions.back().NpT = lNBins;
+  fRegions.back().Axes = lAxisInd;
+};
+int GFW::AddWeights(const GFWWeightTable &table) {
+  fWeights.push_back(table);
+  return (int)fWeights.size()-1;
+};
+int GFW::AddWeights(string fileName) {
+  GFWWeightTable lTable;
+  if(!lTable.Load(fileName)) return -1;
+  return AddWeights(lTable);
+};
+void GFW::UseWeights(int index, string regionName) {
+  if(index<0 || index>=(int)fWeights.size()) { printf("Weight table %i does not exist!\n",index); return; };
+  int lReg = FindRegionByName(regionName);
+  if(lReg<0) { printf("Could not find region %s to use weights!\n",regionName.c_str()); return; };
+  fRegions[lReg].Weights = index;
+};
+void GFW::UseWeights(int index, int bitMask) {
+  if(index<0 || index>=(int)fWeights.size()) { printf("Weight table %i does not exist!\n",index); return; };
+  for(auto &reg: fRegions) if(reg.BitMask&bitMask) reg.Weights = index;
+};
+const double *GFW::GetTrackWeights(double eta, int ptin, double phi, double weight) {
+  fTrackWeights.resize(fWeights.size());
+  for(int i: fUsedWeights) fTrackWeights[i] = weight*fWeights[i].Get(phi,eta,ptin);
+  return fTrackWeights.data();
+};
+int GFW::GetBinIndex(const vector<int> &bins) {
+  if(bins.size()!=fAxes.size()) return -1;
+  int retInd=0;
+  for(int i=0;i<(int)fAxes.size();i++) {
+    if(bins[i]<0 || bins[i]>=fAxes[i].NBins) return -1;
+    retInd+=bins[i]*fAxes[i].Stride;
+  };
+  return retInd;
+};
+void GFW::BuildBinMaps() {
+  fRegionBinMap.assign(fRegions.size(),vector<int>{});
+  for(int i=0;i<(int)fRegions.size();i++) {
+    const vector<int> &lAxes = fRegions[i].Axes;
+    if(lAxes.empty()) continue;
+    fRegionBinMap[i].resize(fNBins);
+    for(int bin=0;bin<fNBins;bin++) {
+      //Bins of the region are ordered with the first of its axes running fastest
+      int lBin=0, lStride=1;
+      for(int axis: lAxes) {
+        lBin+=((bin/fAxes[axis].Stride)%fAxes[axis].NBins)*lStride;
+        lStride*=fAxes[axis].NBins;
+      };
+      fRegionBinMap[i][bin]=lBin;
+    };
+  };
+};
+int GFW::GetSubeventBin(const CorrConfig &corconf, int subevent, int ptbin) {
+  if(corconf.ptInd[subevent]>-1) return corconf.ptInd[subevent]; //Fixed in the configuration
+  const Region &lPoi = fRegions[corconf.Regs[subevent][0]];
+  if(lPoi.Axes.empty()) return ptbin;
+  //Unselected axes of the POI region are looped over (first one running fastest), and selected ones are fixed
+  const vector<int> *lSel = (subevent<(int)corconf.BinSel.size() && !corconf.BinSel[subevent].empty())?&corconf.BinSel[subevent]:0;
+  int lBin=0, lStride=1, lRemaining=ptbin, lFreeBins=1;
+  for(int axis: lPoi.Axes) {
+    int lAxisBin = lSel?lSel->at(axis):-1;
+    if(lAxisBin<0) {
+      lAxisBin = lRemaining%fAxes[axis].NBins;
+      lRemaining/=fAxes[axis].NBins;
+      lFreeBins*=fAxes[axis].NBins;
+    };
+    lBin+=lAxisBin*lStride;
+    lStride*=fAxes[axis].NBins;
+  };
+  if(lFreeBins==1) return lBin; //All bins are selected, so the subevent does not depend on ptbin (same as a region with one bin)
+  return (ptbin<0 || lRemaining>0)?lPoi.NpT:lBin; //Out of range, i.e. not filled
+};
+int GFW::GetSubeventNBins(const CorrConfig &corconf, int subevent) {
+  if(corconf.ptInd[subevent]>-1) return 1;
+  const Region &lPoi = fRegions[corconf.Regs[subevent][0]];
+  const vector<int> *lSel = (subevent<(int)corconf.BinSel.size() && !corconf.BinSel[subevent].empty())?&corconf.BinSel[subevent]:0;
+  int retBins=1;
+  for(int axis: lPoi.Axes) if(!lSel || lSel->at(axis)<0) retBins*=fAxes[axis].NBins;
+  return retBins;
 };
 int GFW::CreateRegions() {
-  for(auto pItr = fCumulants.begin(); pItr != fCumulants.end(); ++pItr)
-    pItr->DestroyComplexVectorArray();
-  fCumulants.clear();
+  fCumulants.clear(); //Cumulants own their Q-vectors, so clearing also releases the memory
   InitializePowerArrays();
+  //Regions restored from a state file can refer to weight tables that were not added
+  for(auto &reg: fRegions) if(reg.Weights>=(int)fWeights.size()) { printf("Weight table %i of region %s does not exist! Region is filled without weights.\n",reg.Weights,reg.rName.c_str()); reg.Weights=-1; };
+  //Only the tables used by some region are looked up while filling (slice groups take the tables of their regions)
+  fUsedWeights.clear();
+  for(int i=0;i<(int)fWeights.size();i++)
+    for(auto &reg: fRegions) if(reg.Weights==i) { fUsedWeights.push_back(i); break; };
   if(fRegions.size()<1) {
     printf("No regions set. Skipping...\n");
     return 0;
   };
+  //Plan only depends on the regions and configurations, and tells which terms are needed in each region
+  CompilePlan();
+  vector<TermSet> lTerms = fPlan.GetTerms((int)fRegions.size());
   int nRegions=0;
-  for(auto pItr=fRegions.begin(); pItr!=fRegions.end(); pItr++) {
-    GFWCumulant *lCumulant = new GFWCumulant();
-    lCumulant->CreateComplexVectorArrayVarPower(pItr->Nhar, pItr->NparVec, pItr->NpT);
-    fCumulants.push_back(*lCumulant);
+  fCumulants.reserve(fRegions.size());
+  for(int i=0;i<(int)fRegions.size();i++) {
+    fCumulants.emplace_back();
+    fCumulants.back().SetPrecision(fRegions[i].precision);
+    fCumulants.back().SetPooled(fPoolMinBins>0 && fRegions[i].NpT>=fPoolMinBins);
+    if(fRegions[i].sparseTerms) fCumulants.back().CreateComplexVectorArraySparse(lTerms[i], fRegions[i].NpT);
+    else fCumulants.back().CreateComplexVectorArrayVarPower(fRegions[i].Nhar, fRegions[i].NparVec, fRegions[i].NpT);
+    fCumulants.back().SetPhiSegments(fSegmentPhi);
     ++nRegions;
   };
+  BuildSliceGroups(lTerms);
+  BuildEtaRouting();
+  BuildBinMaps();
+#ifdef GFW_INSTRUMENT
+  fInstrument.Clear();
+  for(int i=0;i<(int)fRegions.size();i++) fInstrument.AddRegion(fRegions[i].rName,fRegions[i].Nhar,fRegions[i].NpT,fCumulants[i].GetNTerms(),fCumulants[i].GetQBytes());
+  for(auto &cfg: fListOfCFGs) fInstrument.AddConfig(cfg.Head);
+#endif
+  fLayout++;
   if(nRegions) fInitialized=true;
   return nRegions;
 };
+int GFW::UpdateRegions() {
+  if(!fInitialized) return CreateRegions();
+  int nCompiled = (int)fOutputOffset.size();
+  int nConfigs = (int)fListOfCFGs.size();
+  if(nCompiled==nConfigs) return 0;
+  //Regions read by the new configurations. Only these can miss some terms
+  vector<vector<vector<int> > > harSets((int)fRegions.size());
+  vector<bool> isAffected(fRegions.size(),false);
+  for(int iCfg=nCompiled;iCfg<nConfigs;iCfg++)
+    for(auto oneHar:GetHarmonicsSingleConfig(fListOfCFGs[iCfg])) isAffected[oneHar.first]=true;
+  for(const CorrConfig &lConf:fListOfCFGs)
+    for(auto oneHar:GetHarmonicsSingleConfig(lConf)) if(isAffected[oneHar.first]) harSets[oneHar.first].push_back(oneHar.second);
+  //Power arrays are recalculated for the affected regions where they were derived from the configurations
+  for(int i=0;i<(int)fRegions.size();i++) {
+    if(!isAffected[i] || !fRegions[i].powsDerived) continue;
+    fRegions[i].NparVec = GFWPowerArray::GetPowerArray(harSets[i]);
+    fRegions[i].Nhar = (int)fRegions[i].NparVec.size();
+  };
+  //New configurations are appended to the plan and to the output of CalculateAll, so the existing ones keep their indices
+  fPlan.SetNConfigs(nConfigs);
+  for(int iCfg=nCompiled;iCfg<nConfigs;iCfg++) {
+    fOutputOffset.push_back(fNOutputs);
+    fNOutputs+=GetConfigNpT(fListOfCFGs[iCfg]);
+  };
+  for(int iCfg=nCompiled;iCfg<nConfigs;iCfg++) CompileConfig(iCfg);
+  fCompileCache.clear();
+  fPlanEvaluated=false;
+  //Affected regions are extended with the terms they miss. Q-vectors that are already filled are kept
+  vector<TermSet> lTerms = fPlan.GetTerms((int)fRegions.size());
+  int nExtended=0;
+  for(int i=0;i<(int)fRegions.size();i++) {
+    if(!isAffected[i]) continue;
+    if(!fRegions[i].powsDerived) { //Powers were set by the user, so they are not changed
+      for(auto &term: lTerms[i]) if(!fCumulants[i].HasTerm(term.first,term.second)) { printf("Powers of region %s were set explicitly and do not cover the new configurations!\n",fRegions[i].rName.c_str()); break; };
+      continue;
+    };
+    if(IsRegionSliced(i)) continue; //Extended together with the slices of its group
+    if(fCumulants[i].AddTerms(GetRegionTerms(i,lTerms))) nExtended++;
+  };
+  //Regions built from eta slices must have the same terms as the slices, so the whole group is extended
+  for(auto &grp: fSliceGroups) {
+    bool isGroupAffected=false;
+    for(int reg: grp.Regions) isGroupAffected|=isAffected[reg];
+    if(!isGroupAffected) continue;
+    TermSet lGroupTerms = GetSliceGroupTerms(grp,lTerms);
+    for(auto &slice: grp.Slices) slice.AddTerms(lGroupTerms);
+    for(auto &prefix: grp.Prefix) prefix.AddTerms(lGroupTerms);
+    for(int reg: grp.Regions) if(fCumulants[reg].AddTerms(lGroupTerms)) nExtended++;
+  };
+  fLayout++;
+#ifdef GFW_INSTRUMENT
+  for(int i=0;i<(int)fRegions.size();i++) if(isAffected[i]) fInstrument.UpdateRegion(i,fRegions[i].Nhar,fCumulants[i].GetNTerms(),fCumulants[i].GetQBytes());
+  for(int iCfg=nCompiled;iCfg<nConfigs;iCfg++) fInstrument.AddConfig(fListOfCFGs[iCfg].Head);
+#endif
+  return nExtended;
+};
+TermSet GFW::GetRegionTerms(int reg, const vector<TermSet> &planTerms) {
+  if(fRegions[reg].sparseTerms) return planTerms[reg];
+  TermSet retTerms;
+  for(int l_n=0;l_n<fRegions[reg].Nhar;l_n++) for(int l_p=0;l_p<fRegions[reg].NparVec[l_n];l_p++) retTerms.push_back(make_pair(l_n,l_p));
+  return retTerms;
+};
+TermSet GFW::GetSliceGroupTerms(const SliceGroup &grp, const vector<TermSet> &planTerms) {
+  TermSet retTerms;
+  for(int reg: grp.Regions) {
+    TermSet lTerms = GetRegionTerms(reg,planTerms);
+    retTerms.insert(retTerms.end(),lTerms.begin(),lTerms.end());
+  };
+  GFWPowerArray::NormalizeTermSet(retTerms);
+  return retTerms;
+};
+void GFW::BuildSliceGroups(const vector<TermSet> &planTerms) {
+  fSliceGroups.clear();
+  fSliceEdges.clear();
+  fRegionSliceGroup.assign(fRegions.size(),-1);
+  fSlicesFinalized=true;
+  if(fNEtaSlices<1) return;
+  if(fSliceEtaMin>=fSliceEtaMax) { printf("Eta slices: min. cannot be more than max.! Filling all regions directly.\n"); return; };
+  double lWidth = (fSliceEtaMax-fSliceEtaMin)/fNEtaSlices;
+  fSliceEdges.resize(fNEtaSlices+1);
+  for(int k=0;k<=fNEtaSlices;k++) fSliceEdges[k] = fSliceEtaMin+k*lWidth;
+  fSliceEdges[fNEtaSlices] = fSliceEtaMax;
+  //Regions with both edges on the slice edges (up to rounding) are built from the slices. Groups share the bit mask and binning
+  for(int i=0;i<(int)fRegions.size();i++) {
+    const Region &reg = fRegions[i];
+    double lLo = (reg.EtaMin-fSliceEtaMin)/lWidth, lHi = (reg.EtaMax-fSliceEtaMin)/lWidth;
+    int lo = (int)std::lround(lLo), hi = (int)std::lround(lHi);
+    if(lo<0 || hi>fNEtaSlices || lo>=hi || std::fabs(lLo-lo)>1e-6 || std::fabs(lHi-hi)>1e-6) continue;
+    //Exact values of region edges are used, so that tracks at the edges end up in the same regions as with the regular routing
+    fSliceEdges[lo] = reg.EtaMin;
+    fSliceEdges[hi] = reg.EtaMax;
+    int iGroup=0;
+    for(;iGroup<(int)fSliceGroups.size();iGroup++) {
+      const SliceGroup &grp = fSliceGroups[iGroup];
+      if(grp.BitMask==reg.BitMask && grp.NpT==reg.NpT && grp.Axes==reg.Axes && grp.Weights==reg.Weights) break;
+    };
+    if(iGroup==(int)fSliceGroups.size()) {
+      fSliceGroups.emplace_back();
+      fSliceGroups.back().BitMask = reg.BitMask;
+      fSliceGroups.back().NpT = reg.NpT;
+      fSliceGroups.back().Axes = reg.Axes;
+      fSliceGroups.back().Weights = reg.Weights;
+    };
+    SliceGroup &grp = fSliceGroups[iGroup];
+    grp.Regions.push_back(i);
+    grp.SliceLo.push_back(lo);
+    grp.SliceHi.push_back(hi);
+    fRegionSliceGroup[i] = iGroup;
+  };
+  //Slices are always kept in double precision, since regions are obtained as differences of their sums. Regions of a group get the same terms as the slices
+  for(auto &grp: fSliceGroups) {
+    TermSet lGroupTerms = GetSliceGroupTerms(grp,planTerms);
+    bool isPooled = fPoolMinBins>0 && grp.NpT>=fPoolMinBins;
+    grp.Slices.resize(fNEtaSlices);
+    grp.Prefix.resize(fNEtaSlices);
+    for(int s=0;s<fNEtaSlices;s++) {
+      grp.Slices[s].SetPooled(isPooled);
+      grp.Slices[s].CreateComplexVectorArraySparse(lGroupTerms,grp.NpT);
+      grp.Slices[s].SetPhiSegments(fSegmentPhi);
+      grp.Prefix[s].SetPooled(isPooled);
+      grp.Prefix[s].CreateComplexVectorArraySparse(lGroupTerms,grp.NpT);
+    };
+    for(int reg: grp.Regions) fCumulants[reg].CreateComplexVectorArraySparse(lGroupTerms,grp.NpT);
+    grp.Counts.assign(fNEtaSlices*grp.NpT,0);
+    grp.PrefixCounts.assign(fNEtaSlices*grp.NpT,0);
+  };
+};
+int GFW::FindEtaSlice(double eta) {
+  if(!(eta>=fSliceEdges.front() && eta<=fSliceEdges.back())) return -1;
+  int k = std::upper_bound(fSliceEdges.begin(),fSliceEdges.end(),eta)-fSliceEdges.begin();
+  if(fSliceEdges[k-1]==eta) return 2*(k-1)+1; //Exactly on the edge
+  return 2*(k-1);
+};
+int GFW::GetSliceBin(const SliceGroup &grp, int ptin) {
+  if(grp.NpT==1) return 0; //As in GFWCumulant::FillArray, a single bin is filled regardless of ptin
+  int retBin = GetRegionBin(grp.Regions[0],ptin);
+  return (retBin<0 || retBin>=grp.NpT)?-1:retBin;
+};
+void GFW::BuildSlicedRegions() {
+  fSlicesFinalized=true;
+  for(auto &grp: fSliceGroups) {
+    int nPt = grp.NpT;
+    //Prefix sums over slices. Only the bins that were filled are summed
+    for(int s=0;s<fNEtaSlices;s++) {
+      GFWCumulant &lPrefix = grp.Prefix[s];
+      lPrefix.ResetQs();
+      for(int lBin: grp.Slices[s].GetFilledBins()) lPrefix.AddBin(lBin,grp.Slices[s]);
+      lPrefix.AddEntries(grp.Slices[s].GetN());
+      if(s) {
+        for(int lBin: grp.Prefix[s-1].GetFilledBins()) lPrefix.AddBin(lBin,grp.Prefix[s-1]);
+        lPrefix.AddEntries(grp.Prefix[s-1].GetN());
+      };
+      for(int lBin: lPrefix.GetFilledBins())
+        grp.PrefixCounts[s*nPt+lBin] = grp.Counts[s*nPt+lBin] + ((s && grp.Prefix[s-1].IsPtBinFilled(lBin))?grp.PrefixCounts[(s-1)*nPt+lBin]:0);
+    };
+    //Each region is then the difference between two prefix sums. Bins without tracks in the region are left empty
+    for(int i=0;i<(int)grp.Regions.size();i++) {
+      int lo = grp.SliceLo[i], hi = grp.SliceHi[i];
+      GFWCumulant &lReg = fCumulants[grp.Regions[i]];
+      GFWCumulant &lUpper = grp.Prefix[hi-1];
+      GFWCumulant *lLower = lo?&grp.Prefix[lo-1]:0;
+      lReg.ResetQs();
+      for(int lBin: lUpper.GetFilledBins()) {
+        int nTracks = grp.PrefixCounts[(hi-1)*nPt+lBin] - ((lLower && lLower->IsPtBinFilled(lBin))?grp.PrefixCounts[(lo-1)*nPt+lBin]:0);
+        if(!nTracks) continue;
+        lReg.AddBin(lBin,lUpper,lLower);
+        lReg.AddEntries(nTracks);
+      };
+      for(auto &trk: grp.EdgeTracks) if(trk.Edge>lo && trk.Edge<hi) lReg.FillArray(trk.Bin,trk.Phi,trk.Weight,trk.SecondWeight);
+    };
+  };
+};
+void GFW::BuildEtaRouting() {
+  fEtaEdges.clear();
+  for(int i=0;i<(int)fRegions.size();i++) {
+    if(IsRegionSliced(i)) continue;
+    fEtaEdges.push_back(fRegions[i].EtaMin);
+    fEtaEdges.push_back(fRegions[i].EtaMax);
+  };
+  std::sort(fEtaEdges.begin(),fEtaEdges.end());
+  fEtaEdges.erase(std::unique(fEtaEdges.begin(),fEtaEdges.end()),fEtaEdges.end());
+  //Regions sorted by EtaMin, so that we can stop looking once EtaMin is beyond the slot
+  vector<int> lOrder;
+  for(int i=0;i<(int)fRegions.size();i++) lOrder.push_back(i);
+  std::stable_sort(lOrder.begin(),lOrder.end(),[this](int a, int b) { return fRegions[a]<fRegions[b]; });
+  //Slots: 2k is the open interval (edge[k-1], edge[k]), 2k+1 is edge[k] itself. Region contains the slot if EtaMin<eta<EtaMax for all eta in it
+  int nEdges = (int)fEtaEdges.size();
+  int nSlots = 2*nEdges+1;
+  fSlotOffsets.assign(1,0);
+  fSlotRegions.clear();
+  fSlotMasks.clear();
+  fSlotWeights.clear();
+  fSlotMaskOr.assign(nSlots,0);
+  for(int iSlot=0;iSlot<nSlots;iSlot++) {
+    int k = iSlot/2;
+    bool isEdge = iSlot%2;
+    for(int ind: lOrder) {
+      if(IsRegionSliced(ind)) continue;
+      const Region &reg = fRegions[ind];
+      bool contains;
+      if(isEdge) {
+        if(reg.EtaMin>=fEtaEdges[k]) break;
+        contains = reg.EtaMax>fEtaEdges[k];
+      } else {
+        if(k==nEdges || reg.EtaMin>=fEtaEdges[k]) break;
+        contains = (k>0) && reg.EtaMin<=fEtaEdges[k-1] && reg.EtaMax>=fEtaEdges[k];
+      };
+      if(!contains) continue;
+      fSlotRegions.push_back(ind);
+      fSlotMasks.push_back(reg.BitMask);
+      fSlotWeights.push_back(reg.Weights);
+      fSlotMaskOr[iSlot]|=reg.BitMask;
+    };
+    fSlotOffsets.push_back((int)fSlotRegions.size());
+  };
+};
+int GFW::FindEtaSlot(double eta) {
+  int k = std::upper_bound(fEtaEdges.begin(),fEtaEdges.end(),eta)-fEtaEdges.begin();
+  if(k>0 && fEtaEdges[k-1]==eta) return 2*(k-1)+1; //Exactly on the edge
+  return 2*k;
+};
 void GFW::Fill(double eta, int ptin, double phi, double weight, int mask, double SecondWeight) {
   // if(!fInitialized) return;
-  for(int i=0;i<(int)fRegions.size();++i) {
-    if(fRegions.at(i).EtaMin<eta && fRegions.at(i).EtaMax>eta && (fRegions.at(i).BitMask&mask))
-      fCumulants.at(i).FillArray(ptin,phi,weight,SecondWeight);
+  if(fSlotMaskOr.empty()) return; //Regions have not been created yet
+  fPlanEvaluated=false;
+  const double *lTableWeights = fUsedWeights.empty()?0:GetTrackWeights(eta,ptin,phi,weight);
+  if(!fSliceGroups.empty()) {
+    int lSlice = FindEtaSlice(eta);
+    if(lSlice>-1) for(auto &grp: fSliceGroups) {
+      if(!(grp.BitMask&mask)) continue;
+      int lBin = GetSliceBin(grp,ptin);
+      if(lBin<0) continue;
+      fSlicesFinalized=false;
+      double lWeight = (grp.Weights<0)?weight:lTableWeights[grp.Weights];
+      if(lSlice%2) { grp.EdgeTracks.push_back({lSlice/2, lBin, phi, lWeight, SecondWeight}); continue; };
+      grp.Slices[lSlice/2].FillArray(lBin,phi,lWeight,SecondWeight);
+      grp.Counts[(lSlice/2)*grp.NpT+lBin]++;
+    };
+  };
+  int lSlot = FindEtaSlot(eta);
+  if(!(fSlotMaskOr[lSlot]&mask)) return;
+  for(int i=fSlotOffsets[lSlot];i<fSlotOffsets[lSlot+1];++i) {
+    if(!(fSlotMasks[i]&mask)) continue;
+    fCumulants[fSlotRegions[i]].FillArray(GetRegionBin(fSlotRegions[i],ptin),phi,(fSlotWeights[i]<0)?weight:lTableWeights[fSlotWeights[i]],SecondWeight);
+    GFW_INSTR(fInstrument.CountTracks(fSlotRegions[i],1));
   };
 };
+void GFW::Fill(int nTracks, const double *eta, const int *ptin, const double *phi, const double *weight, const int *mask, const double *secondWeight) {
+  if(fSlotMaskOr.empty()) return; //Regions have not been created yet
+  fPlanEvaluated=false;
+  int nChunks = std::max(1,std::min(fFillPool.GetNThreads(),nTracks/kMinTracksPerThread));
+  if((int)fFillBuffers.size()<nChunks) fFillBuffers.resize(nChunks);
+  if(nChunks==1) { FillChunk(0,nTracks,eta,ptin,phi,weight,mask,secondWeight); return; };
+  //Private Q-vectors are only (re)created when the terms have changed, and not while the first chunk fills the regions
+  for(int iChunk=1;iChunk<nChunks;iChunk++) if(fFillBuffers[iChunk].Layout!=fLayout) PrepareFillBuffer(fFillBuffers[iChunk]);
+  //Chunks only depend on the number of tracks and threads, so the order of additions is always the same
+  fFillPool.Run(nChunks,[&](int iChunk) {
+    int lFirst = (int)((long)nTracks*iChunk/nChunks);
+    int lLast = (int)((long)nTracks*(iChunk+1)/nChunks);
+    FillChunk(iChunk,lLast-lFirst,eta+lFirst,ptin+lFirst,phi+lFirst,weight+lFirst,mask+lFirst,secondWeight?secondWeight+lFirst:0);
+  });
+  fFillPool.Run(fFillPool.GetNThreads(),[&](int iTask) { ReduceChunks(iTask,fFillPool.GetNThreads(),nChunks); });
+  //Tracks at slice edges are kept in order of chunks, as in the serial Fill
+  for(int iChunk=1;iChunk<nChunks;iChunk++) {
+    FillBuffer &buf = fFillBuffers[iChunk];
+    for(int iGroup=0;iGroup<(int)fSliceGroups.size();iGroup++) {
+      vector<EdgeTrack> &lEdges = fSliceGroups[iGroup].EdgeTracks;
+      lEdges.insert(lEdges.end(),buf.EdgeTracks[iGroup].begin(),buf.EdgeTracks[iGroup].end());
+      if(!buf.EdgeTracks[iGroup].empty()) fSlicesFinalized=false;
+    };
+    for(auto &trk: buf.SliceTracks) if(!trk.phi.empty()) { fSlicesFinalized=false; break; };
+#ifdef GFW_INSTRUMENT
+    for(int i=0;i<(int)buf.RegionTracks.size();i++) fInstrument.CountTracks(i,(long)buf.RegionTracks[i].phi.size());
+#endif
+  };
+};
+void GFW::PrepareFillBuffer(FillBuffer &buf) {
+  //Copies keep the terms, binning, precision and pooling of the originals, and are then emptied
+  buf.Cumulants = fCumulants;
+  for(auto &cum: buf.Cumulants) cum.ResetQs();
+  buf.Slices.clear();
+  buf.Counts.clear();
+  for(auto &grp: fSliceGroups) {
+    for(auto &slice: grp.Slices) {
+      buf.Slices.push_back(slice);
+      buf.Slices.back().ResetQs();
+    };
+    buf.Counts.push_back(vector<int>(fNEtaSlices*grp.NpT,0));
+  };
+  buf.EdgeTracks.assign(fSliceGroups.size(),vector<EdgeTrack>());
+  buf.Layout = fLayout;
+};
+void GFW::FillChunk(int iChunk, int nTracks, const double *eta, const int *ptin, const double *phi, const double *weight, const int *mask, const double *secondWeight) {
+  FillBuffer &buf = fFillBuffers[iChunk];
+  bool isPrivate = iChunk>0;
+  buf.RegionTracks.resize(fRegions.size());
+  buf.SliceTracks.resize(fSliceGroups.size()*fNEtaSlices);
+  for(auto &trk: buf.RegionTracks) trk.clear();
+  for(auto &trk: buf.SliceTracks) trk.clear();
+  if(isPrivate) { //Only the bins filled in the previous event are reset
+    for(auto &cum: buf.Cumulants) cum.ResetQs();
+    for(int i=0;i<(int)buf.Slices.size();i++) {
+      int iGroup = i/fNEtaSlices, lSlice = i%fNEtaSlices;
+      for(int lBin: buf.Slices[i].GetFilledBins()) buf.Counts[iGroup][lSlice*fSliceGroups[iGroup].NpT+lBin]=0;
+      buf.Slices[i].ResetQs();
+    };
+    for(auto &edges: buf.EdgeTracks) edges.clear();
+  };
+  //Weight tables are looked up for all the tracks at once, and the weights are then shared by all regions that use the same table
+  buf.TableWeights.resize(fWeights.size());
+  for(int i: fUsedWeights) {
+    buf.TableWeights[i].resize(nTracks);
+    fWeights[i].Lookup(nTracks,phi,eta,ptin,weight,buf.TableWeights[i].data());
+  };
+  //First, route all the tracks to respective regions (and eta slices)
+  for(int iTrack=0;iTrack<nTracks;iTrack++) {
+    int lSlice = fSliceGroups.empty()?-1:FindEtaSlice(eta[iTrack]);
+    if(lSlice>-1) for(int iGroup=0;iGroup<(int)fSliceGroups.size();iGroup++) {
+      SliceGroup &grp = fSliceGroups[iGroup];
+      if(!(grp.BitMask&mask[iTrack])) continue;
+      int lBin = GetSliceBin(grp,ptin[iTrack]);
+      if(lBin<0) continue;
+      double lWeight = (grp.Weights<0)?weight[iTrack]:buf.TableWeights[grp.Weights][iTrack];
+      if(lSlice%2) { (isPrivate?buf.EdgeTracks[iGroup]:grp.EdgeTracks).push_back({lSlice/2, lBin, phi[iTrack], lWeight, secondWeight?secondWeight[iTrack]:-1}); continue; };
+      TrackBatch &trk = buf.SliceTracks[iGroup*fNEtaSlices+lSlice/2];
+      trk.ptin.push_back(lBin);
+      trk.phi.push_back(phi[iTrack]);
+      trk.weight.push_back(lWeight);
+      if(secondWeight) trk.secondWeight.push_back(secondWeight[iTrack]);
+    };
+    int lSlot = FindEtaSlot(eta[iTrack]);
+    if(!(fSlotMaskOr[lSlot]&mask[iTrack])) continue;
+    for(int i=fSlotOffsets[lSlot];i<fSlotOffsets[lSlot+1];++i) {
+      if(!(fSlotMasks[i]&mask[iTrack])) continue;
+      TrackBatch &trk = buf.RegionTracks[fSlotRegions[i]];
+      trk.ptin.push_back(GetRegionBin(fSlotRegions[i],ptin[iTrack]));
+      trk.phi.push_back(phi[iTrack]);
+      trk.weight.push_back((fSlotWeights[i]<0)?weight[iTrack]:buf.TableWeights[fSlotWeights[i]][iTrack]);
+      if(secondWeight) trk.secondWeight.push_back(secondWeight[iTrack]);
+    };
+  };
+  //Then fill each region with its own batch of tracks
+  for(int i=0;i<(int)buf.RegionTracks.size();i++) {
+    TrackBatch &trk = buf.RegionTracks[i];
+    if(trk.phi.empty()) continue;
+    (isPrivate?buf.Cumulants[i]:fCumulants[i]).FillArray((int)trk.phi.size(),trk.ptin.data(),trk.phi.data(),trk.weight.data(),secondWeight?trk.secondWeight.data():0);
+#ifdef GFW_INSTRUMENT
+    if(!isPrivate) fInstrument.CountTracks(i,(long)trk.phi.size());
+#endif
+  };
+  for(int i=0;i<(int)buf.SliceTracks.size();i++) {
+    TrackBatch &trk = buf.SliceTracks[i];
+    if(trk.phi.empty()) continue;
+    SliceGroup &grp = fSliceGroups[i/fNEtaSlices];
+    int lSlice = i%fNEtaSlices;
+    (isPrivate?buf.Slices[i]:grp.Slices[lSlice]).FillArray((int)trk.phi.size(),trk.ptin.data(),trk.phi.data(),trk.weight.data(),secondWeight?trk.secondWeight.data():0);
+    int *lCounts = (isPrivate?buf.Counts[i/fNEtaSlices]:grp.Counts).data()+lSlice*grp.NpT;
+    for(int lBin: trk.ptin) lCounts[lBin]++;
+    if(!isPrivate) fSlicesFinalized=false;
+  };
+  if(!isPrivate) for(auto &grp: fSliceGroups) if(!grp.EdgeTracks.empty()) fSlicesFinalized=false;
+};
+void GFW::ReduceChunks(int iTask, int nTasks, int nChunks) {
+  int nRegions = (int)fCumulants.size();
+  int nUnits = nRegions+(int)fSliceGroups.size()*fNEtaSlices;
+  for(int iUnit=iTask;iUnit<nUnits;iUnit+=nTasks) {
+    if(iUnit<nRegions) {
+      for(int iChunk=1;iChunk<nChunks;iChunk++) {
+        const GFWCumulant &lPart = fFillBuffers[iChunk].Cumulants[iUnit];
+        if(lPart.GetN()<=0) continue;
+        for(int lBin: lPart.GetFilledBins()) fCumulants[iUnit].AddBin(lBin,lPart);
+        fCumulants[iUnit].AddEntries(lPart.GetN());
+      };
+      continue;
+    };
+    int i = iUnit-nRegions;
+    int iGroup = i/fNEtaSlices, lSlice = i%fNEtaSlices;
+    SliceGroup &grp = fSliceGroups[iGroup];
+    for(int iChunk=1;iChunk<nChunks;iChunk++) {
+      const GFWCumulant &lPart = fFillBuffers[iChunk].Slices[i];
+      if(lPart.GetN()<=0) continue;
+      const int *lCounts = fFillBuffers[iChunk].Counts[iGroup].data()+lSlice*grp.NpT;
+      for(int lBin: lPart.GetFilledBins()) {
+        grp.Slices[lSlice].AddBin(lBin,lPart);
+        grp.Counts[lSlice*grp.NpT+lBin]+=lCounts[lBin];
+      };
+      grp.Slices[lSlice].AddEntries(lPart.GetN());
+    };
+  };
+};
+void GFW::FillSegment(double eta, int ptin, int segment, double weight, int mask, double SecondWeight) {
+  if(fSlotMaskOr.empty()) return; //Regions have not been created yet
+  if(segment<0 || segment>=(int)fSegmentPhi.size()) return;
+  fPlanEvaluated=false;
+  const double *lTableWeights = fUsedWeights.empty()?0:GetTrackWeights(eta,ptin,fSegmentPhi[segment],weight);
+  if(!fSliceGroups.empty()) {
+    int lSlice = FindEtaSlice(eta);
+    if(lSlice>-1) for(auto &grp: fSliceGroups) {
+      if(!(grp.BitMask&mask)) continue;
+      int lBin = GetSliceBin(grp,ptin);
+      if(lBin<0) continue;
+      fSlicesFinalized=false;
+      double lWeight = (grp.Weights<0)?weight:lTableWeights[grp.Weights];
+      //Hits at slice edges are rare, so these are filled into the regions with the phi of the segment
+      if(lSlice%2) { grp.EdgeTracks.push_back({lSlice/2, lBin, fSegmentPhi[segment], lWeight, SecondWeight}); continue; };
+      grp.Slices[lSlice/2].FillSegment(lBin,segment,lWeight,SecondWeight);
+      grp.Counts[(lSlice/2)*grp.NpT+lBin]++;
+      fSegmentsFlushed=false;
+    };
+  };
+  int lSlot = FindEtaSlot(eta);
+  if(!(fSlotMaskOr[lSlot]&mask)) return;
+  for(int i=fSlotOffsets[lSlot];i<fSlotOffsets[lSlot+1];++i) {
+    if(!(fSlotMasks[i]&mask)) continue;
+    fCumulants[fSlotRegions[i]].FillSegment(GetRegionBin(fSlotRegions[i],ptin),segment,(fSlotWeights[i]<0)?weight:lTableWeights[fSlotWeights[i]],SecondWeight);
+    fSegmentsFlushed=false;
+    GFW_INSTR(fInstrument.CountTracks(fSlotRegions[i],1));
+  };
+};
+void GFW::FillSegments(int nHits, const double *eta, const int *ptin, const int *segment, const double *weight, const int *mask, const double *secondWeight) {
+  //Hits only add to the weight sums, so there is nothing to gain from batching them per region
+  for(int i=0;i<nHits;i++) FillSegment(eta[i],ptin[i],segment[i],weight[i],mask[i],secondWeight?secondWeight[i]:-1);
+};
+void GFW::FlushSegments() {
+  fSegmentsFlushed=true;
+  for(auto &cum: fCumulants) cum.FlushSegments();
+  for(auto &grp: fSliceGroups) for(auto &slice: grp.Slices) slice.FlushSegments();
+};
 complex<double> GFW::TwoRec(int n1, int n2, int p1, int p2, int ptbin, GFWCumulant *r1, GFWCumulant *r2, GFWCumulant *r3) {
   complex<double> part1 = r1->Vec(n1,p1,ptbin);
   complex<double> part2 = r2->Vec(n2,p2,ptbin);
@@ -97,6 +660,7 @@ complex<double> GFW::RecursiveCorr(GFWCumulant *qpoi, GFWCumulant *qref, GFWCumu
 };
 
 complex<double> GFW::RecursiveCorr(GFWCumulant *qpoi, GFWCumulant *qref, GFWCumulant *qol, int ptbin, vector<int> &hars, vector<int> &pows) {
+  GFW_INSTR(fInstrument.CountRecursion());
   if((pows.at(0)!=1) && qol) qpoi=qol; //if the power of POI is not unity, then always use overlap (if defined).
   //Only valid for 1 particle of interest though!
   if(hars.size()<2) return qpoi->Vec(hars.at(0),pows.at(0),ptbin);
@@ -132,14 +696,27 @@ complex<double> GFW::RecursiveCorr(GFWCumulant *qpoi, GFWCumulant *qref, GFWCumu
 void GFW::Clear() {
   if(!fInitialized) CreateRegions();
   for(auto ptr = fCumulants.begin(); ptr!=fCumulants.end(); ++ptr) ptr->ResetQs();
+  for(auto &grp: fSliceGroups) {
+    for(int s=0;s<fNEtaSlices;s++) {
+      for(int lBin: grp.Slices[s].GetFilledBins()) grp.Counts[s*grp.NpT+lBin]=0;
+      grp.Slices[s].ResetQs();
+    };
+    grp.EdgeTracks.clear();
+  };
+  fSlicesFinalized=true; //Regions built from slices are empty, as are the slices
+  fSegmentsFlushed=true;
+  fPlanEvaluated=false;
 };
-GFW::CorrConfig GFW::GetCorrelatorConfig(string config, string head, bool ptdif) {
+GFW::CorrConfig GFW::GetCorrelatorConfig(string config, string head, bool ptdif, int engine) {
   //First remove all ; and ,:
   s_replace_all(config,","," ");
   s_replace_all(config,";"," ");
   s_replace_all(config,"| ","|");
   //If pT-bin is provided, then look for & remove space before "(" (so that it's clean afterwards)
   while(s_index(config," (")>-1) s_replace_all(config," (","(");
+  //Bin selection on axes is given as name=bin, so remove spaces around "="
+  while(s_index(config," =")>-1) s_replace_all(config," =","=");
+  while(s_index(config,"= ")>-1) s_replace_all(config,"= ","=");
   //Then make sure we don't have any double-spaces:
   while(s_index(config,"  ")>-1) s_replace_all(config,"  "," ");
   vector<int> regs;
@@ -168,7 +745,19 @@ GFW::CorrConfig GFW::GetCorrelatorConfig(string config, string head, bool ptdif)
       sz2 = s_index(ts,"(");
       sz1=sz2+1;
       s_tokenize(ts,ts2,sz1,")");
-      ptbin=stoi(ts2);
+      if(s_contains(ts2,"=")) { //Bins selected on axes, e.g. "(charge=1 species=0)"
+        ReturnConfig.BinSel.resize(counter);
+        ReturnConfig.BinSel[counter-1].assign(fAxes.size(),-1);
+        int sz3=0;
+        string ts3;
+        while(s_tokenize(ts2,ts3,sz3," ")) {
+          int lEq = s_index(ts3,"=");
+          if(lEq<0) continue;
+          int lAxis = FindAxisByName(ts3.substr(0,lEq));
+          if(lAxis<0) { printf("Could not find axis named %s!\n",ts3.substr(0,lEq).c_str()); continue; };
+          ReturnConfig.BinSel[counter-1][lAxis] = stoi(ts3.substr(lEq+1));
+        };
+      } else ptbin=stoi(ts2);
       ts.erase(sz2,(sz1-sz2+1));
       szend-=(sz1-sz2); //szend also becomes shorter
       //also need to remove this from config now:
@@ -199,8 +788,11 @@ GFW::CorrConfig GFW::GetCorrelatorConfig(string config, string head, bool ptdif)
     //Fetch harmonics
     while(s_tokenize(harstr,ts,dummys," ")) ReturnConfig.Hars.at(counter-1).push_back(stoi(ts));
   };
+  if(!ReturnConfig.BinSel.empty()) ReturnConfig.BinSel.resize(ReturnConfig.Regs.size());
   ReturnConfig.Head = head;
   ReturnConfig.pTDif = ptdif;
+  ReturnConfig.Engine = engine;
+  ReturnConfig.Index = (int)fListOfCFGs.size();
   // ReturnConfig.pTbin = ptbin;
   fListOfCFGs.push_back(ReturnConfig);
   return ReturnConfig;
@@ -214,13 +806,15 @@ complex<double> GFW::Calculate(int poi, int ref, vector<int> hars, int ptbin) {
 };
 complex<double> GFW::Calculate(CorrConfig corconf, int ptbin, bool SetHarmsToZero) {
   // if(!fInitialized) return complex<double>(0,0); //First check if initialised, if not -- initialize, and if it fails, return
+  GFW_INSTR(GFWInstrument::ConfigScope lScope(fInstrument,corconf.Index,corconf.Head));
   if(corconf.Regs.size()==0) return complex<double>(0,0); //Check if we have any regions at all
+  FinalizeQs();
+  bool lUsePlan = IsPlanConfig(corconf);
   complex<double> retval(1,0);
   int ptInd;
   for(int i=0;i<(int)corconf.Regs.size();i++) { //looping over all regions
     if(corconf.Regs.at(i).size()==0)  return complex<double>(0,0); //again, if no regions in the current subevent, then quit immediatelly
-    ptInd = corconf.ptInd.at(i); //for i=0 (potentially, POI)
-    if(ptInd<0) ptInd = ptbin;
+    ptInd = GetSubeventBin(corconf,i,ptbin); //Fixed in the configuration, or given by ptbin
     //picking up the indecies of regions...
     int poi = corconf.Regs.at(i).at(0);
     int ref = (corconf.Regs.at(i).size()>1)?corconf.Regs.at(i).at(1):corconf.Regs.at(i).at(0);
@@ -228,22 +822,100 @@ complex<double> GFW::Calculate(CorrConfig corconf, int ptbin, bool SetHarmsToZer
     //and regions themselves
     GFWCumulant *qref = &fCumulants.at(ref);
     GFWCumulant *qpoi = &fCumulants.at(poi);
-    if(!qref->IsPtBinFilled(ptInd)) return complex<double>(0,0); //if REF is not filled, don't even continue. Could be redundant, but should save little CPU time
-    if(!qpoi->IsPtBinFilled(ptInd)) return complex<double>(0,0);//if POI is not filled, don't even continue. Could be redundant, but should save little CPU time
+    if(!IsSubeventFilled(corconf,i,ptbin)) return complex<double>(0,0);
     GFWCumulant *qovl=0;
-    //Check if in the ref. region we have enough particles (no. of particles in the region >= no of harmonics for subevent)
-    int sz1 = corconf.Hars.at(i).size();
-    if(poi!=ref) sz1--;
-    if(qref->GetN() < sz1) return complex<double>(0,0);
     //Then, figure the overlap
     if(ovl > -1) //if overlap is defined, then (unless it's explicitly disabled)
       qovl = &fCumulants.at(ovl);
     else if(ref==poi) qovl = qref; //If ref and poi are the same, then the same is for overlap. Only, when OL not explicitly defined
+    //If the configuration has been compiled, take the value from the evaluation plan. Otherwise, calculate it recursively
+    int lRoot = lUsePlan?fPlan.GetRoot(corconf.Index, ptbin, SetHarmsToZero, i):-1;
+    if(lRoot>-1) {
+      if(!fPlanEvaluated) { GFW_INSTR(fInstrument.StartPlan()); fPlan.Evaluate(fCumulants); GFW_INSTR(fInstrument.StopPlan()); fPlanEvaluated=true; };
+      retval *= fPlan.GetValue(lRoot);
+      continue;
+    };
     if(SetHarmsToZero) for(int j=0;j<(int)corconf.Hars.at(i).size();j++) corconf.Hars.at(i).at(j) = 0;
-    retval *= RecursiveCorr(qpoi, qref, qovl, ptInd, corconf.Hars.at(i));
+    //Regions only store the terms of the configurations known at CreateRegions (or UpdateRegions), so the others can miss some of them
+    qpoi->TakeMissedTerm(); qref->TakeMissedTerm(); if(qovl) qovl->TakeMissedTerm();
+    int h1, h2, na, nb;
+    int lKernelPt = GetKernelShape(poi,ref,(ovl<0 && ref==poi)?ref:ovl,ptInd,corconf.Hars.at(i),h1,h2,na,nb);
+    if(lKernelPt>-1) retval *= GFWKernels::Evaluate(*qpoi,lKernelPt,h1,h2,na,nb);
+    else if(UsePartitions(corconf,i)) retval *= GFWPartitions::Evaluate(qpoi, qref, qovl, ptInd, corconf.Hars.at(i));
+    else retval *= RecursiveCorr(qpoi, qref, qovl, ptInd, corconf.Hars.at(i));
+    bool isMissing = qpoi->TakeMissedTerm();
+    isMissing |= qref->TakeMissedTerm();
+    if(qovl) isMissing |= qovl->TakeMissedTerm();
+    if(isMissing) {
+      if(!fMissingTermsReported) printf("Configuration %s needs Q-vectors that are not stored in its regions (call UpdateRegions() after adding configurations). Returning 0!\n",corconf.Head.c_str());
+      fMissingTermsReported=true;
+      return complex<double>(0,0);
+    };
   }
   return retval;
 };
+bool GFW::IsPlanConfig(const CorrConfig &corconf) {
+  if(corconf.Index<0 || corconf.Index>=(int)fOutputOffset.size()) return false; //Not compiled (yet)
+  const CorrConfig &lCompiled = fListOfCFGs[corconf.Index];
+  return corconf.Regs==lCompiled.Regs && corconf.Hars==lCompiled.Hars && corconf.Overlap==lCompiled.Overlap && corconf.ptInd==lCompiled.ptInd
+      && corconf.BinSel==lCompiled.BinSel && corconf.Engine==lCompiled.Engine;
+};
+bool GFW::IsSubeventFilled(const CorrConfig &corconf, int subevent, int ptbin) {
+  int ptInd = GetSubeventBin(corconf,subevent,ptbin);
+  int poi = corconf.Regs[subevent][0];
+  int ref = (corconf.Regs[subevent].size()>1)?corconf.Regs[subevent][1]:corconf.Regs[subevent][0];
+  if(!fCumulants[ref].IsPtBinFilled(ptInd)) return false; //if REF is not filled, don't even continue. Could be redundant, but should save little CPU time
+  if(!fCumulants[poi].IsPtBinFilled(ptInd)) return false; //if POI is not filled, don't even continue. Could be redundant, but should save little CPU time
+  //Check if in the ref. region we have enough particles (no. of particles in the region >= no of harmonics for subevent)
+  int sz1 = corconf.Hars[subevent].size();
+  if(poi!=ref) sz1--;
+  return fCumulants[ref].GetN() >= sz1;
+};
+bool GFW::IsSubeventPtDif(const CorrConfig &corconf, int subevent) {
+  //Subevent depends on the pT bin only if it is not fixed in the configuration and any of the regions involved is pT-differential
+  if(corconf.ptInd[subevent]>-1) return false;
+  if(!fRegions[corconf.Regs[subevent][0]].Axes.empty()) return GetSubeventNBins(corconf,subevent)>1; //Only unselected axes are looped over
+  for(int reg: corconf.Regs[subevent]) if(fRegions[reg].NpT>1) return true;
+  return (corconf.Overlap[subevent]>-1) && fRegions[corconf.Overlap[subevent]].NpT>1;
+};
+void GFW::CalculateAll(pair<double, double> *out) {
+  FinalizeQs();
+  if(!fPlanEvaluated) { GFW_INSTR(fInstrument.StartPlan()); fPlan.Evaluate(fCumulants); GFW_INSTR(fInstrument.StopPlan()); fPlanEvaluated=true; };
+  for(int iCfg=0;iCfg<(int)fOutputOffset.size();iCfg++) {
+    GFW_INSTR(GFWInstrument::ConfigScope lScope(fInstrument,iCfg,fListOfCFGs[iCfg].Head,true));
+    const CorrConfig &cfg = fListOfCFGs[iCfg];
+    pair<double, double> *lOut = out + fOutputOffset[iCfg];
+    int lNpT = (iCfg+1<(int)fOutputOffset.size()?fOutputOffset[iCfg+1]:fNOutputs) - fOutputOffset[iCfg];
+    int nSub = (int)cfg.Regs.size();
+    //First, the part that does not depend on pT bin (e.g. reference subevents) is calculated only once
+    bool isFilled = fPlan.GetRoot(iCfg,0,false,0)>-1;
+    complex<double> lVal(1,0), lNorm(1,0);
+    for(int i=0;i<nSub && isFilled;i++) {
+      if(IsSubeventPtDif(cfg,i)) continue;
+      isFilled = IsSubeventFilled(cfg,i,0);
+      lVal *= fPlan.GetValue(fPlan.GetRoot(iCfg,0,false,i));
+      lNorm *= fPlan.GetValue(fPlan.GetRoot(iCfg,0,true,i));
+    };
+    for(int ptbin=0;ptbin<lNpT;ptbin++) {
+      lOut[ptbin] = make_pair(0.,0.);
+      if(!isFilled) continue;
+      complex<double> lPtVal = lVal, lPtNorm = lNorm;
+      bool isPtFilled = true;
+      for(int i=0;i<nSub && isPtFilled;i++) {
+        if(!IsSubeventPtDif(cfg,i)) continue;
+        isPtFilled = IsSubeventFilled(cfg,i,ptbin);
+        lPtVal *= fPlan.GetValue(fPlan.GetRoot(iCfg,ptbin,false,i));
+        lPtNorm *= fPlan.GetValue(fPlan.GetRoot(iCfg,ptbin,true,i));
+      };
+      if(!isPtFilled || lPtNorm.real()==0) continue;
+      lOut[ptbin] = make_pair(lPtVal.real()/lPtNorm.real(), lPtNorm.real());
+    };
+  };
+};
+int GFW::GetOutputIndex(int cfgIndex, int ptbin) {
+  if(cfgIndex<0 || cfgIndex>=(int)fOutputOffset.size()) return -1;
+  return fOutputOffset[cfgIndex]+ptbin;
+};
 vector<pair<int, vector<int> > > GFW::GetHarmonicsSingleConfig(const CorrConfig &incfg) {
   vector<pair<int, vector<int> > > retPair;
   for(int iR=0; iR<(int)incfg.Regs.size(); iR++) {
@@ -263,13 +935,163 @@ void GFW::InitializePowerArrays() {
   };
   //Now, loop through all combinations of different harmonics for each region and calculate power arrays
   for(int i=0; i<(int)harSets.size();i++) {
-    if(fRegions[i].powsDefined) continue; //Only do if powers have not been externally defined
+    if(fRegions[i].powsDefined && !fRegions[i].powsDerived) continue; //Only do if powers have not been externally defined
     vector<int> powerArray = GFWPowerArray::GetPowerArray(harSets[i]);
     fRegions[i].Nhar = (int)powerArray.size();
     fRegions[i].NparVec = powerArray;
     fRegions[i].powsDefined=true;
+    fRegions[i].powsDerived=true;
+    fRegions[i].sparseTerms=fUseSparseTerms;
   }
 };
+int GFW::GetConfigNpT(const CorrConfig &incfg) {
+  //Number of pT bins to loop over: for pT-differential configurations, the largest number of pT bins of all the regions involved
+  if(!incfg.pTDif) return 1;
+  //For regions with axes, only the bins of axes that are not selected in the configuration are counted
+  int lNpT=1;
+  for(int i=0;i<(int)incfg.Regs.size();i++) {
+    for(int reg: incfg.Regs[i]) lNpT = std::max(lNpT,fRegions[reg].Axes.empty()?fRegions[reg].NpT:GetSubeventNBins(incfg,i));
+    int ovl = incfg.Overlap[i];
+    if(ovl>-1) lNpT = std::max(lNpT,fRegions[ovl].Axes.empty()?fRegions[ovl].NpT:GetSubeventNBins(incfg,i));
+  };
+  return lNpT;
+};
+void GFW::CompilePlan() {
+  fPlan.Clear();
+  fPlanEvaluated=false;
+  fPlan.SetNConfigs((int)fListOfCFGs.size());
+  //Layout of the CalculateAll output: configurations one after another, and pT-differential ones occupy one entry per pT bin
+  fOutputOffset.clear();
+  fNOutputs=0;
+  for(auto &cfg: fListOfCFGs) {
+    fOutputOffset.push_back(fNOutputs);
+    fNOutputs+=GetConfigNpT(cfg);
+  };
+  for(int iCfg=0;iCfg<(int)fListOfCFGs.size();iCfg++) CompileConfig(iCfg);
+  fCompileCache.clear();
+};
+void GFW::CompileConfig(int iCfg) {
+  const CorrConfig &cfg = fListOfCFGs[iCfg];
+  int nSub = (int)cfg.Regs.size();
+  bool isValid = nSub>0;
+  for(int i=0;i<nSub;i++) if(cfg.Regs[i].empty() || cfg.Hars[i].empty()) isValid=false;
+  if(!isValid) return; //Leave it for Calculate to deal with
+  int lNpT = GetConfigNpT(cfg);
+  fPlan.AddConfig(iCfg,lNpT,nSub);
+  for(int ptbin=0;ptbin<lNpT;ptbin++) {
+    for(int i=0;i<nSub;i++) {
+      //Same logic as in Calculate
+      int ptInd = GetSubeventBin(cfg,i,ptbin);
+      int poi = cfg.Regs[i][0];
+      int ref = (cfg.Regs[i].size()>1)?cfg.Regs[i][1]:cfg.Regs[i][0];
+      int ovl = cfg.Overlap[i];
+      if(ovl<0 && ref==poi) ovl=ref;
+      for(int zero=0;zero<2;zero++) {
+        vector<int> hars = cfg.Hars[i];
+        if(zero) for(int &har: hars) har=0;
+        int h1, h2, na, nb;
+        int lKernelPt = GetKernelShape(poi,ref,ovl,ptInd,hars,h1,h2,na,nb);
+        if(lKernelPt>-1) {
+          fPlan.SetRoot(iCfg,ptbin,zero,i,fPlan.AddKernel(poi,lKernelPt,h1,h2,na,nb));
+          continue;
+        };
+        if(UsePartitions(cfg,i)) {
+          fPlan.SetRoot(iCfg,ptbin,zero,i,CompilePartitions(poi,ref,ovl,ptInd,hars));
+          continue;
+        };
+        vector<int> pows(hars.size(),1);
+        fPlan.SetRoot(iCfg,ptbin,zero,i,CompileCorr(poi,ref,ovl,ptInd,hars,pows));
+      };
+    };
+  };
+};
+int GFW::GetKernelShape(int poi, int ref, int ovl, int ptbin, const vector<int> &hars, int &h1, int &h2, int &na, int &nb) {
+  //Kernels only cover a single region, where POI, ref, and overlap are all the same
+  if(!fUseKernels || poi!=ref || ovl!=ref) return -1;
+  if(!GFWKernels::GetShape(hars,h1,h2,na,nb)) return -1;
+  if(ptbin>=fRegions[poi].NpT || ptbin<0) ptbin=0;
+  //RecursiveCorr takes reference Q-vectors beyond the second particle from the first pT bin, so for more particles only the first bin is equivalent
+  if(na+nb>2 && ptbin>0) return -1;
+  return ptbin;
+};
+int GFW::CompileLeaf(int reg, int har, int pow, int ptbin) {
+  //Same as GFWCumulant::Vec, out-of-range pT bins fall back to the first one
+  if(ptbin>=fRegions[reg].NpT || ptbin<0) ptbin=0;
+  return fPlan.AddLeaf(reg,har,pow,ptbin);
+};
+int GFW::CompileCorr(int poi, int ref, int ovl, int ptbin, vector<int> &hars, vector<int> &pows) {
+  if((pows.at(0)!=1) && ovl>-1) poi=ovl; //if the power of POI is not unity, then always use overlap (if defined).
+  if(hars.size()<2) return CompileLeaf(poi,hars.at(0),pows.at(0),ptbin);
+  vector<int> lKey = {poi, ref, ovl, ptbin};
+  lKey.insert(lKey.end(),hars.begin(),hars.end());
+  lKey.insert(lKey.end(),pows.begin(),pows.end());
+  auto itr = fCompileCache.find(lKey);
+  if(itr!=fCompileCache.end()) return itr->second;
+  int retNode;
+  if(hars.size()<3) { //Same as TwoRec
+    vector<pair<int, int> > lSub;
+    if(ovl>-1) lSub.push_back(make_pair(CompileLeaf(ovl,hars.at(0)+hars.at(1),pows.at(0)+pows.at(1),ptbin),1));
+    retNode = fPlan.AddMulSub(CompileLeaf(poi,hars.at(0),pows.at(0),ptbin),CompileLeaf(ref,hars.at(1),pows.at(1),ptbin),lSub);
+  } else {
+    int harlast=hars.at(hars.size()-1);
+    int powlast=pows.at(pows.size()-1);
+    hars.erase(hars.end()-1);
+    pows.erase(pows.end()-1);
+    int lPrev = CompileCorr(poi, ref, ovl, ptbin, hars, pows);
+    int lLast = CompileLeaf(ref, harlast, powlast, 0); //Reference is always taken from the first pT bin, as in RecursiveCorr
+    vector<pair<int, int> > lSub;
+    int lDegeneracy=1;
+    int harSize = (int)hars.size();
+    for(int i=harSize-1;i>=0;i--) {
+      if(i>2) {
+        if(hars.at(i) == hars.at(i-1) && pows.at(i) == pows.at(i-1)) {
+          lDegeneracy++;
+          continue;
+        };
+      }
+      hars.at(i)+=harlast;
+      pows.at(i)+=powlast;
+      lSub.push_back(make_pair(CompileCorr(poi, ref, ovl, ptbin, hars, pows),lDegeneracy));
+      lDegeneracy=1;
+      hars.at(i)-=harlast;
+      pows.at(i)-=powlast;
+    };
+    hars.push_back(harlast);
+    pows.push_back(powlast);
+    retNode = fPlan.AddMulSub(lPrev,lLast,lSub);
+  };
+  fCompileCache[lKey] = retNode;
+  return retNode;
+};
+int GFW::CompilePartitions(int poi, int ref, int ovl, int ptbin, const vector<int> &hars) {
+  //Same steps as GFWPartitions::Evaluate. Identical nodes (e.g. partitions of the reference for different pT bins) are merged by the plan
+  if(hars.size()<2) return CompileLeaf(poi,hars.at(0),1,ptbin);
+  GFWPartitions::Multiset lSet = GFWPartitions::MakeMultiset(vector<int>(hars.begin()+2,hars.end()));
+  vector<GFWPartitions::Block> lBlocks;
+  vector<GFWPlan::Product> lProducts;
+  vector<int> lRest(lSet.NStates,-1); //Empty set is 1, i.e. no operand
+  for(int index=1;index<lSet.NStates;index++) {
+    GFWPartitions::GetBlocks(lSet,index,true,0,0,lBlocks);
+    lProducts.clear();
+    for(auto &block: lBlocks) lProducts.push_back({CompileLeaf(ref,block.Har,block.Pow,0),lRest[block.Rest],block.Coef});
+    lRest[index] = fPlan.AddSumProd(lProducts);
+  };
+  vector<int> lSecond(lSet.NStates);
+  for(int index=0;index<lSet.NStates;index++) {
+    GFWPartitions::GetBlocks(lSet,index,false,hars[1],1,lBlocks);
+    lProducts.clear();
+    for(auto &block: lBlocks) lProducts.push_back({CompileLeaf(ref,block.Har,block.Pow,ptbin),lRest[block.Rest],block.Coef});
+    lSecond[index] = fPlan.AddSumProd(lProducts);
+  };
+  vector<GFWPlan::Product> lTop;
+  GFWPartitions::GetBlocks(lSet,lSet.NStates-1,false,hars[0],1,lBlocks);
+  for(auto &block: lBlocks) lTop.push_back({CompileLeaf((block.Pow>1 && ovl>-1)?ovl:poi,block.Har,block.Pow,ptbin),lSecond[block.Rest],block.Coef});
+  if(ovl>-1) {
+    GFWPartitions::GetBlocks(lSet,lSet.NStates-1,false,hars[0]+hars[1],2,lBlocks);
+    for(auto &block: lBlocks) lTop.push_back({CompileLeaf(ovl,block.Har,block.Pow,ptbin),lRest[block.Rest],block.Coef});
+  };
+  return fPlan.AddSumProd(lTop);
+};
 complex<double> GFW::Calculate(int poi, vector<int> hars) {
   GFWCumulant *qpoi = &fCumulants.at(poi);
   return RecursiveCorr(qpoi, qpoi, qpoi, 0, hars);
@@ -9,6 +9,11 @@ If used, modified, or distributed, please aknowledge the author of this code.
 #define GFW__H
 #include "GFWCumulant.h"
 #include "GFWPowerArray.h"
+#include "GFWPlan.h"
+#include "GFWPartitions.h"
+#include "GFWInstrument.h"
+#include "GFWThreadPool.h"
+#include "GFWWeightTable.h"
 #include <vector>
 #include <utility>
 #include <algorithm>
@@ -18,6 +23,10 @@ using std::complex;
 using std::string;
 class GFW {
  public:
+  //Engine used to calculate correlators that are not covered by the closed-form kernels: recursion (GFW::RecursiveCorr) or set partitions (GFWPartitions).
+  //With kAutoEngine, set partitions are used for subevents with at least kPartitionMinParticles particles
+  enum Engine_t {kAutoEngine=0, kRecursion=1, kPartitions=2};
+  static const int kPartitionMinParticles = 4;
   struct Region {
     int Nhar, NpT;
     vector<int> NparVec{};
@@ -26,6 +35,11 @@ class GFW {
     int BitMask=1;
     string rName="";
     bool powsDefined=false;
+    int precision=GFWCumulant::kDouble; //Storage precision of Q-vectors, see GFWCumulant::Precision_t
+    vector<int> Axes{}; //Bin axes of the region (indices of GFW axes). NpT is then the product of their number of bins
+    bool powsDerived=false; //Powers were derived from the configurations, so they can be extended by UpdateRegions
+    bool sparseTerms=false; //Powers were derived from the configurations, so only the terms read by the compiled plan need to be stored
+    int Weights=-1; //Weight table applied to tracks filled into the region (see UseWeights), or -1
     bool operator<(const Region& a) const {
       return EtaMin < a.EtaMin;
     };
@@ -36,30 +50,194 @@ class GFW {
     vector<vector<int> > Hars{};
     vector<int> Overlap;
     vector<int> ptInd;
+    vector<vector<int> > BinSel{}; //For regions with axes: selected bin on each GFW axis (-1 if not selected), per subevent. Empty if nothing is selected
     bool pTDif=false;
     string Head="";
+    int Index=-1; //Index in the list of configurations of GFW that created it, used to look up the compiled evaluation plan
+    int Engine=kAutoEngine; //See Engine_t
   };
   GFW();
   ~GFW();
   vector<Region> fRegions;
   vector<GFWCumulant> fCumulants;
-  void AddRegion(string refName, double lEtaMin, double lEtaMax, int lNpT, int BitMask);
-  void AddRegion(string refName, vector<int> lNparVec, double lEtaMin, double lEtaMax, int lNpT, int BitMask); //Legacy
-  void AddRegion(string refName, int lNhar, int lNpar, double lEtaMin, double lEtaMax, int lNpT, int BitMask); //Legacy support, all powers are the same
-  void AddRegion(string refName, int lNhar, int *lNparVec, double lEtaMin, double lEtaMax, int lNpT, int BitMask); //Legacy support, array instead of a vector
+  //Q-vectors can optionally be stored in single precision (GFWCumulant::kFloat), see GFWCumulant::Precision_t for the accuracy
+  void AddRegion(string refName, double lEtaMin, double lEtaMax, int lNpT, int BitMask, int precision=GFWCumulant::kDouble);
+  void AddRegion(string refName, vector<int> lNparVec, double lEtaMin, double lEtaMax, int lNpT, int BitMask, int precision=GFWCumulant::kDouble); //Legacy
+  void AddRegion(string refName, int lNhar, int lNpar, double lEtaMin, double lEtaMax, int lNpT, int BitMask, int precision=GFWCumulant::kDouble); //Legacy support, all powers are the same
+  void AddRegion(string refName, int lNhar, int *lNparVec, double lEtaMin, double lEtaMax, int lNpT, int BitMask, int precision=GFWCumulant::kDouble); //Legacy support, array instead of a vector
+  //Multi-dimensional binning: axes (e.g. pT, charge, species) are added to GFW first, and regions are then binned in any subset of them.
+  //Tracks are filled with a single bin index (instead of pT bin), obtained with GetBinIndex from bins on all the axes. Each region maps it to its own bin with a lookup table
+  int AddAxis(string axisName, int nBins); //Returns index of the axis, or -1. Regions binned in pT without axes cannot be mixed with axes
+  void AddRegion(string refName, double lEtaMin, double lEtaMax, vector<string> lAxes, int BitMask, int precision=GFWCumulant::kDouble);
+  int GetBinIndex(const vector<int> &bins); //Bin index for Fill from bins on each of the axes (in order they were added), or -1 if out of range
+  int GetNBins() { return fNBins; }; //Total number of bins of all axes
   int CreateRegions();
+  //Configurations fetched after CreateRegions can be added without rebuilding: they are compiled into the existing plan (and appended to the output of CalculateAll),
+  //and only regions that miss some of the needed terms are extended, keeping their Q-vectors. Regions with explicitly set powers are not changed.
+  //Returns the number of extended regions. If CreateRegions has not been called yet, it is called instead
+  int UpdateRegions();
   void Fill(double eta, int ptin, double phi, double weight, int mask, double secondWeight=-1);
+  //Batched version for a whole event: tracks are routed to regions first and then each region is filled with one batch. secondWeight can be null
+  void Fill(int nTracks, const double *eta, const int *ptin, const double *phi, const double *weight, const int *mask, const double *secondWeight=0);
+  //Hits of segmented detectors (e.g. forward calorimeters), given by the index of a phi segment (see SetPhiSegments) instead of phi. They are routed to
+  //regions (and eta slices) as in Fill, but only weight sums per segment are accumulated, and Q-vectors are built from these once per event (see GFWCumulant::FillSegment)
+  void FillSegment(double eta, int ptin, int segment, double weight, int mask, double secondWeight=-1);
+  void FillSegments(int nHits, const double *eta, const int *ptin, const int *segment, const double *weight, const int *mask, const double *secondWeight=0);
+  //Phi of each segment for FillSegment (e.g. centres of calorimeter towers). Has to be set before CreateRegions
+  void SetPhiSegments(const vector<double> &segmentPhi) { fSegmentPhi = segmentPhi; };
+  int GetNPhiSegments() { return (int)fSegmentPhi.size(); };
   void Clear();
-  GFWCumulant GetCumulant(int index) { return fCumulants.at(index); };
-  CorrConfig GetCorrelatorConfig(string config, string head = "", bool ptdif=false);
+  GFWCumulant GetCumulant(int index) { FinalizeQs(); return fCumulants.at(index); };
+  const vector<GFWCumulant> &GetCumulants() { FinalizeQs(); return fCumulants; }; //Q-vectors of all regions for the current event
+  CorrConfig GetCorrelatorConfig(string config, string head = "", bool ptdif=false, int engine=kAutoEngine);
   complex<double> Calculate(CorrConfig corconf, int ptbin, bool SetHarmsToZero);
+  //Calculates all the configurations compiled in CreateRegions at once. For each configuration (and each pT bin of pT-differential ones),
+  //out is filled with (value, weight), where value is already normalized by the weight (number of combinations). Entries that cannot be calculated are (0,0)
+  //out must hold at least GetNOutputs() entries; index of a given configuration and pT bin is GetOutputIndex(CorrConfig.Index, ptbin)
+  void CalculateAll(pair<double, double> *out);
+  int GetNOutputs() { return fNOutputs; };
+  const vector<CorrConfig> &GetConfigs() { return fListOfCFGs; };
+  int GetOutputIndex(int cfgIndex, int ptbin=0);
+  int GetConfigNpT(const CorrConfig &incfg); //Number of (pT) bins of a configuration in the output of CalculateAll
+  //Bin of a region for the bin index passed to Fill (-1 if it is out of range), and bin of the regions of a subevent for a given (pT) bin of the configuration
+  int GetRegionBin(int reg, int bin) { return (fRegionBinMap[reg].empty())?bin:((bin>=0 && bin<fNBins)?fRegionBinMap[reg][bin]:-1); };
+  int GetSubeventBin(const CorrConfig &corconf, int subevent, int ptbin);
   void InitializePowerArrays();
+  void CompilePlan(); //Called by CreateRegions
+  void SetUseKernels(bool newval) { fUseKernels = newval; }; //Use closed-form kernels (GFWKernels) where possible. Has to be set before CreateRegions
+  //Store and fill only the (harmonic, power) terms that the configurations need, for regions with automatically derived powers. Has to be set before CreateRegions
+  void SetUseSparseTerms(bool newval) { fUseSparseTerms = newval; };
+  //Regions with at least minBins (pT) bins allocate Q-vectors of a bin only when it is filled (see GFWCumulant::SetPooled); 0 disables it. Has to be set before CreateRegions
+  void SetPooledStorage(int minBins) { fPoolMinBins = minBins; };
+  //Fine eta binning for eta-gap scans: tracks are filled once into nSlices equal eta slices in [etaMin, etaMax] (separately for each bit mask and binning of regions),
+  //and regions whose edges coincide with slice edges are built from prefix sums over the slices once per event, on the first call to Calculate, instead of
+  //filling every track into each of them. Other regions are filled as usual. Has to be set before CreateRegions; nSlices=0 disables it
+  void SetEtaSlices(int nSlices, double etaMin, double etaMax) { fNEtaSlices = nSlices; fSliceEtaMin = etaMin; fSliceEtaMax = etaMax; };
+  bool IsRegionSliced(int reg) { return reg>=0 && reg<(int)fRegionSliceGroup.size() && fRegionSliceGroup[reg]>-1; }; //Region is built from eta slices
+  //Intra-event parallel filling for events with many tracks: the batched Fill splits the tracks into up to nThreads contiguous chunks (of at least
+  //kMinTracksPerThread tracks), which are filled in parallel into private Q-vectors that are kept between events, and these are then added to the regions.
+  //The result agrees with the serial Fill up to rounding, and does not depend on the scheduling. Threads are persistent; 1 (default) fills serially, <=0 uses all cores
+  void SetFillThreads(int nThreads) { fFillPool.SetNThreads(nThreads); };
+  int GetFillThreads() { return fFillPool.GetNThreads(); };
+  static const int kMinTracksPerThread = 1000;
+  //Weight tables (e.g. NUA and NUE corrections, see GFWWeightTable) that are looked up while filling, so that tracks do not need precomputed weights: in regions that
+  //use a table, the weight passed to Fill is multiplied by the value of the table for the track. Each table is looked up once per track for all the regions
+  //that use it (in the batched Fill, for all tracks at once), and tables used by no region are not looked up. secondWeight is used as given
+  int AddWeights(const GFWWeightTable &table); //Returns index of the table
+  int AddWeights(string fileName); //Reads the table from a file (see GFWWeightTable), returns -1 if it cannot be read
+  GFWWeightTable &GetWeights(int index) { return fWeights.at(index); }; //Values can be changed at any time
+  int GetNWeights() { return (int)fWeights.size(); };
+  //Regions that use a given table, by name or by bit mask (all regions whose bit masks overlap with bitMask). Has to be set before CreateRegions
+  void UseWeights(int index, string regionName);
+  void UseWeights(int index, int bitMask);
+  void SetEventValue(string name, double value) { for(auto &table: fWeights) table.SetEventValue(name,value); }; //Event variables of the tables (e.g. "vz"), before filling an event
+  GFWPlan &GetPlan() { return fPlan; };
+  GFWInstrument &GetInstrument() { return fInstrument; }; //Counters and timing, only filled with -DGFW_INSTRUMENT
 protected:
+  friend class GFWStateWriter; //Setup of GFW is saved and restored with GFWStateFile
+  friend class GFWStateReader;
   bool fInitialized;
   vector<CorrConfig> fListOfCFGs;
+  GFWPlan fPlan;
+  bool fUseKernels;
+  bool fUseSparseTerms;
+  int fPoolMinBins;
+  int GetKernelShape(int poi, int ref, int ovl, int ptbin, const vector<int> &hars, int &h1, int &h2, int &na, int &nb); //Returns pT bin for the kernel, or -1 if not applicable
+  bool fPlanEvaluated; //Plan is evaluated at most once per event, on the first call to Calculate
+  map<vector<int>, int> fCompileCache; //! Recursion states that are already compiled
+  int CompileCorr(int poi, int ref, int ovl, int ptbin, vector<int> &hars, vector<int> &pows); //Mirrors RecursiveCorr, but returns a node of the plan
+  int CompileLeaf(int reg, int har, int pow, int ptbin);
+  void CompileConfig(int iCfg); //Adds configuration to the plan
+  int CompilePartitions(int poi, int ref, int ovl, int ptbin, const vector<int> &hars); //Mirrors GFWPartitions::Evaluate, but returns a node of the plan
+  bool UsePartitions(const CorrConfig &corconf, int subevent) { return corconf.Engine==kPartitions || (corconf.Engine==kAutoEngine && (int)corconf.Hars[subevent].size()>=kPartitionMinParticles); };
+  bool IsPlanConfig(const CorrConfig &corconf); //corconf matches the configuration compiled at corconf.Index. Modified copies (or configurations of another GFW) are not taken from the plan
+  bool fMissingTermsReported; //Configurations that read terms which are not stored are reported only once
+  vector<int> fOutputOffset; //Offset of each configuration in the output of CalculateAll
+  int fNOutputs;
+  struct Axis {
+    string Name;
+    int NBins;
+    int Stride; //Stride in the bin index used by Fill
+  };
+  vector<Axis> fAxes;
+  int fNBins; //Product of number of bins of all axes
+  vector<vector<int> > fRegionBinMap; //For regions with axes: bin of the region for each bin index passed to Fill. Empty for other regions
+  void BuildBinMaps();
+  int FindAxisByName(string axisName);
+  int GetSubeventNBins(const CorrConfig &corconf, int subevent); //Number of bins that are not selected in the configuration, for regions with axes
+  GFWInstrument fInstrument; //Always present, so that the layout does not depend on GFW_INSTRUMENT
+  bool IsSubeventFilled(const CorrConfig &corconf, int subevent, int ptbin); //Checks if POI and ref. are filled, and if there are enough particles in ref.
+  bool IsSubeventPtDif(const CorrConfig &corconf, int subevent);
   complex<double> TwoRec(int n1, int n2, int p1, int p2, int ptbin, GFWCumulant*, GFWCumulant*, GFWCumulant*);
   complex<double> RecursiveCorr(GFWCumulant *qpoi, GFWCumulant *qref, GFWCumulant *qol, int ptbin, vector<int> &hars, vector<int> &pows); //POI, Ref. flow, overlapping region
   complex<double> RecursiveCorr(GFWCumulant *qpoi, GFWCumulant *qref, GFWCumulant *qol, int ptbin, vector<int> &hars); //POI, Ref. flow, overlapping region
+  //Routing of tracks to regions. All region eta edges are sorted, and each slot (open interval between two edges, or an edge itself)
+  //keeps a list of regions that contain it together with their bit masks. A track is then routed with a binary search over edges
+  struct TrackBatch {
+    vector<int> ptin;
+    vector<double> phi, weight, secondWeight;
+    void clear() { ptin.clear(); phi.clear(); weight.clear(); secondWeight.clear(); };
+  };
+  vector<double> fEtaEdges; //Sorted unique eta edges of all regions
+  vector<int> fSlotOffsets; //Slot i covers entries [fSlotOffsets[i], fSlotOffsets[i+1]) of the vectors below
+  vector<int> fSlotRegions; //Region indices per slot
+  vector<int> fSlotMasks; //Bit masks of the above regions
+  vector<int> fSlotMaskOr; //OR of all bit masks in a slot, to quickly reject tracks
+  vector<int> fSlotWeights; //Weight tables of the regions in fSlotRegions
+  void BuildEtaRouting();
+  int FindEtaSlot(double eta);
+  //Eta slices, see SetEtaSlices. Regions built from slices are grouped by bit mask and binning, and each group has its own slices with terms of all its regions.
+  //Slices are kept as filled, and prefix sums over them are rebuilt when the regions are (so that tracks can still be added after Calculate)
+  struct EdgeTrack {
+    int Edge, Bin;
+    double Phi, Weight, SecondWeight;
+  };
+  struct SliceGroup {
+    int BitMask, NpT, Weights;
+    vector<int> Axes;
+    vector<int> Regions, SliceLo, SliceHi; //Regions of the group, each covering slices [SliceLo, SliceHi)
+    vector<GFWCumulant> Slices, Prefix; //Q-vectors of tracks in each slice, and their sum over all slices up to (and including) the given one
+    vector<int> Counts, PrefixCounts; //Same for number of tracks, per slice and bin at [slice*NpT + bin]
+    vector<EdgeTrack> EdgeTracks; //Tracks exactly at a slice edge. These only belong to regions that contain the edge, so they are filled into the regions directly
+  };
+  int fNEtaSlices;
+  double fSliceEtaMin, fSliceEtaMax;
+  vector<double> fSliceEdges; //Edges of the slices. Those that coincide with region edges are set to the exact values of the latter
+  vector<SliceGroup> fSliceGroups;
+  vector<int> fRegionSliceGroup; //Slice group of each region, or -1 if the region is filled directly
+  bool fSlicesFinalized; //Regions are up to date with the slices
+  void BuildSliceGroups(const vector<TermSet> &planTerms);
+  void BuildSlicedRegions(); //Prefix sums over slices, and then regions as differences of these
+  //Weight tables, see UseWeights
+  vector<GFWWeightTable> fWeights;
+  vector<int> fUsedWeights; //Tables used by any of the regions, the others are not looked up
+  vector<double> fTrackWeights; //! Weights of the current track for each table, for the single-track Fill
+  const double *GetTrackWeights(double eta, int ptin, double phi, double weight); //Fills the above
+  //Phi segments, see FillSegment
+  vector<double> fSegmentPhi;
+  bool fSegmentsFlushed; //Weight sums of segments have been added to the Q-vectors
+  void FlushSegments();
+  void FinalizeQs() { if(!fSegmentsFlushed) FlushSegments(); if(!fSlicesFinalized) BuildSlicedRegions(); }; //Brings Q-vectors up to date with segments and slices, before they are read
+  int FindEtaSlice(double eta); //2s for a track inside slice s, 2k+1 if it is exactly at edge k, or -1 if outside of the slices
+  int GetSliceBin(const SliceGroup &grp, int ptin); //Bin of the track in the slices of a group, or -1 if out of range
+  TermSet GetRegionTerms(int reg, const vector<TermSet> &planTerms); //Terms that have to be stored in a region
+  TermSet GetSliceGroupTerms(const SliceGroup &grp, const vector<TermSet> &planTerms); //Terms of all regions of a group
+  //Batched Fill in chunks, see SetFillThreads. The first chunk is filled into the regions (and slices) directly, the others into private Q-vectors of their buffers,
+  //which are then added to the regions in order of chunks. All buffers are reused between events
+  struct FillBuffer {
+    vector<TrackBatch> RegionTracks, SliceTracks; //Tracks routed to each region, and to each slice at [group*fNEtaSlices + slice]
+    vector<GFWCumulant> Cumulants, Slices; //Private Q-vectors of regions and slices (same indices as above). Not used by the first chunk
+    vector<vector<int> > Counts; //Number of tracks per slice group, as SliceGroup::Counts. Not used by the first chunk
+    vector<vector<EdgeTrack> > EdgeTracks; //Per slice group. Not used by the first chunk
+    vector<vector<double> > TableWeights; //Weights of the tracks of the chunk, for each weight table
+    int Layout=-1; //fLayout at which the private Q-vectors were created
+  };
+  vector<FillBuffer> fFillBuffers; //! One per chunk
+  GFWThreadPool fFillPool; //!
+  int fLayout; //Incremented whenever the terms of regions or slices change, so that private Q-vectors are recreated
+  void PrepareFillBuffer(FillBuffer &buf); //Private Q-vectors with the same terms as the regions and slices
+  void FillChunk(int iChunk, int nTracks, const double *eta, const int *ptin, const double *phi, const double *weight, const int *mask, const double *secondWeight);
+  void ReduceChunks(int iTask, int nTasks, int nChunks); //Adds private Q-vectors of chunks 1..nChunks-1 to every nTasks-th region and slice, starting from iTask
   void AddRegion(Region inreg) { fRegions.push_back(inreg); };
   Region GetRegion(int index) { return fRegions.at(index); };
   int FindRegionByName(string refName);
@@ -0,0 +1,131 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Event-averaging of correlations calculated with GFW::CalculateAll, see the header for details.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#include "GFWAccumulator.h"
+#include <cstdio>
+#include <cmath>
+GFWAccumulator::GFWAccumulator():
+  fNOutputs(0),
+  fNSubsamples(0),
+  fNEvents(0)
+{
+};
+GFWAccumulator::GFWAccumulator(GFW *inGFW, int nSubsamples):
+  GFWAccumulator()
+{
+  Initialize(inGFW,nSubsamples);
+};
+void GFWAccumulator::Initialize(GFW *inGFW, int nSubsamples) {
+  fNSubsamples = (nSubsamples>0)?nSubsamples:0;
+  BuildLayout(inGFW);
+  Reset();
+};
+void GFWAccumulator::Update(GFW *inGFW) {
+  //New configurations are appended to the output of GFW, so entries of the existing ones stay where they are
+  int nOld = fNOutputs;
+  vector<KahanSum> lOldValue, lOldWeight;
+  lOldValue.swap(fSumValue);
+  lOldWeight.swap(fSumWeight);
+  BuildLayout(inGFW);
+  fSumValue.assign((fNSubsamples+1)*fNOutputs,KahanSum());
+  fSumWeight.assign((fNSubsamples+1)*fNOutputs,KahanSum());
+  for(int iSample=0;iSample<=fNSubsamples;iSample++) {
+    for(int i=0;i<nOld && i<fNOutputs;i++) {
+      fSumValue[iSample*fNOutputs+i] = lOldValue[iSample*nOld+i];
+      fSumWeight[iSample*fNOutputs+i] = lOldWeight[iSample*nOld+i];
+    };
+  };
+};
+void GFWAccumulator::BuildLayout(GFW *inGFW) {
+  fNOutputs = inGFW->GetNOutputs();
+  fNames.assign(fNOutputs,"");
+  fHeadIndex.clear();
+  const vector<GFW::CorrConfig> &lConfigs = inGFW->GetConfigs();
+  for(int iCfg=0;iCfg<(int)lConfigs.size();iCfg++) {
+    int lFirst = inGFW->GetOutputIndex(iCfg,0);
+    if(lFirst<0) break; //Configurations fetched after CreateRegions are not part of the output
+    int lNext = (iCfg+1<(int)lConfigs.size() && inGFW->GetOutputIndex(iCfg+1,0)>-1)?inGFW->GetOutputIndex(iCfg+1,0):fNOutputs;
+    const string &lHead = lConfigs[iCfg].Head;
+    if(fHeadIndex.find(lHead)!=fHeadIndex.end()) printf("Configuration %s is defined more than once, only the first one can be looked up by name!\n",lHead.c_str());
+    else fHeadIndex[lHead] = std::make_pair(lFirst,lNext-lFirst);
+    for(int i=lFirst;i<lNext;i++) fNames[i] = lConfigs[iCfg].pTDif?(lHead+"_pt"+std::to_string(i-lFirst)):lHead;
+  };
+  fResults.resize(fNOutputs);
+};
+void GFWAccumulator::Reset() {
+  fSumValue.assign((fNSubsamples+1)*fNOutputs,KahanSum());
+  fSumWeight.assign((fNSubsamples+1)*fNOutputs,KahanSum());
+  fNEvents=0;
+};
+void GFWAccumulator::Fill(const pair<double, double> *results, int subsample) {
+  KahanSum *lValSub = (subsample>-1 && subsample<fNSubsamples)?&fSumValue[(subsample+1)*fNOutputs]:0;
+  KahanSum *lWeightSub = lValSub?&fSumWeight[(subsample+1)*fNOutputs]:0;
+  for(int i=0;i<fNOutputs;i++) {
+    if(results[i].second==0) continue;
+    double lVal = results[i].first*results[i].second;
+    fSumValue[i].Add(lVal);
+    fSumWeight[i].Add(results[i].second);
+    if(!lValSub) continue;
+    lValSub[i].Add(lVal);
+    lWeightSub[i].Add(results[i].second);
+  };
+  fNEvents++;
+};
+void GFWAccumulator::Fill(GFW *inGFW, int subsample) {
+  inGFW->CalculateAll(fResults.data());
+  Fill(fResults.data(),subsample);
+};
+void GFWAccumulator::Merge(const GFWAccumulator &other) {
+  if(other.fNOutputs!=fNOutputs || other.fNSubsamples!=fNSubsamples) {
+    printf("Cannot merge accumulators with different layouts (%i/%i outputs, %i/%i subsamples)!\n",fNOutputs,other.fNOutputs,fNSubsamples,other.fNSubsamples);
+    return;
+  };
+  for(int i=0;i<(int)fSumValue.size();i++) {
+    fSumValue[i].Add(other.fSumValue[i]);
+    fSumWeight[i].Add(other.fSumWeight[i]);
+  };
+  fNEvents+=other.fNEvents;
+};
+int GFWAccumulator::GetIndex(const string &head, int ptbin) {
+  auto itr = fHeadIndex.find(head);
+  if(itr==fHeadIndex.end() || ptbin<0 || ptbin>=itr->second.second) return -1;
+  return itr->second.first+ptbin;
+};
+double GFWAccumulator::GetValue(int ind, int subsample) {
+  if(ind<0 || ind>=fNOutputs) return 0;
+  int lOffset = (subsample>-1 && subsample<fNSubsamples)?(subsample+1)*fNOutputs:0;
+  double lWeight = fSumWeight[lOffset+ind].Get();
+  return (lWeight!=0)?fSumValue[lOffset+ind].Get()/lWeight:0;
+};
+double GFWAccumulator::GetWeight(int ind, int subsample) {
+  if(ind<0 || ind>=fNOutputs) return 0;
+  int lOffset = (subsample>-1 && subsample<fNSubsamples)?(subsample+1)*fNOutputs:0;
+  return fSumWeight[lOffset+ind].Get();
+};
+double GFWAccumulator::GetError(int ind) {
+  //Spread of the (non-empty) subsamples around their mean, divided by sqrt(N)
+  double lSum=0, lSum2=0;
+  int nFilled=0;
+  for(int i=0;i<fNSubsamples;i++) {
+    if(GetWeight(ind,i)==0) continue;
+    double lVal = GetValue(ind,i);
+    lSum+=lVal;
+    lSum2+=lVal*lVal;
+    nFilled++;
+  };
+  if(nFilled<2) return 0;
+  double lMean = lSum/nFilled;
+  double lVar = (lSum2/nFilled-lMean*lMean)*nFilled/(nFilled-1);
+  return (lVar>0)?sqrt(lVar/nFilled):0;
+};
+void GFWAccumulator::Print() {
+  printf("Accumulated %li events:\n",fNEvents);
+  for(int i=0;i<fNOutputs;i++) {
+    if(fNSubsamples>1) printf("%s: %e +- %e\n",fNames[i].c_str(),GetValue(i),GetError(i));
+    else printf("%s: %e\n",fNames[i].c_str(),GetValue(i));
+  };
+};
@@ -0,0 +1,65 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Event-averaging of correlations calculated with GFW::CalculateAll. For each configuration (identified by its Head) and pT bin, keeps sums of value*weight and weight,
+both for all the events and for each statistical subsample (for error estimation). Sums are compensated (Kahan-Babuska), so that millions of events can be added
+without loss of precision, and accumulators with the same layout can be merged (e.g. from different threads or jobs).
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWACCUMULATOR__H
+#define GFWACCUMULATOR__H
+#include "GFW.h"
+#include <vector>
+#include <string>
+#include <map>
+#include <utility>
+using std::vector;
+using std::string;
+using std::map;
+using std::pair;
+class GFWAccumulator {
+ public:
+  struct KahanSum {
+    double Sum=0, Comp=0;
+    void Add(double val) {
+      double t = Sum+val;
+      if(std::abs(Sum)>=std::abs(val)) Comp += (Sum-t)+val;
+      else Comp += (val-t)+Sum;
+      Sum = t;
+    };
+    void Add(const KahanSum &other) { Add(other.Sum); Add(other.Comp); };
+    double Get() const { return Sum+Comp; };
+  };
+  GFWAccumulator();
+  GFWAccumulator(GFW *inGFW, int nSubsamples=0);
+  void Initialize(GFW *inGFW, int nSubsamples=0); //Layout is taken from GFW::CalculateAll, so GFW has to be initialized (CreateRegions called)
+  void Update(GFW *inGFW); //Extends the layout with configurations added by GFW::UpdateRegions, keeping the sums of the existing ones
+  void Fill(const pair<double, double> *results, int subsample=-1); //Output of GFW::CalculateAll. Negative subsample -> only fill the total
+  void Fill(GFW *inGFW, int subsample=-1); //Calls CalculateAll and fills the results
+  void Merge(const GFWAccumulator &other);
+  void Reset();
+  int GetIndex(const string &head, int ptbin=0); //-1 if not found
+  double GetValue(int ind, int subsample=-1); //Weighted average, <<value>>. 0 if ind is out of range, as for a Head that is not found
+  double GetWeight(int ind, int subsample=-1); //Sum of weights, 0 if ind is out of range
+  double GetValue(const string &head, int ptbin=0, int subsample=-1) { int ind=GetIndex(head,ptbin); return ind<0?0:GetValue(ind,subsample); };
+  double GetError(int ind); //Standard error of the mean, from the spread of subsamples
+  int GetNOutputs() { return fNOutputs; };
+  int GetNSubsamples() { return fNSubsamples; };
+  long GetNEvents() { return fNEvents; };
+  void Print();
+ protected:
+  friend class GFWStateWriter; //Sums are saved and restored with GFWStateFile
+  friend class GFWStateReader;
+  int fNOutputs;
+  int fNSubsamples;
+  long fNEvents;
+  vector<string> fNames; //Head_ptX of each entry
+  map<string, pair<int, int> > fHeadIndex; //Head -> (first entry, number of pT bins)
+  //Sums for total (index 0) and each subsample (1..fNSubsamples), laid out as [sample][entry]
+  vector<KahanSum> fSumValue;
+  vector<KahanSum> fSumWeight;
+  vector<pair<double, double> > fResults; //! Buffer for Fill(GFW*)
+  void BuildLayout(GFW *inGFW);
+};
+#endif
@@ -6,72 +6,329 @@ A container to store Q vectors for one subevent with an extra layer to recursive
 If used, modified, or distributed, please aknowledge the author of this code.
 */
 #include "GFWCumulant.h"
+#include "GFWSimd.h"
+#include "GFWInstrument.h"
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <cstdlib>
 GFWCumulant::GFWCumulant():
   fQvector(0),
+  fQvectorF(0),
+  fPrecision(kDouble),
+  fQBlock(0),
+  fPtStride(0),
   fUsed(kBlank),
   fNEntries(-1),
   fN(1),
   fPow(1),
+  fMaxPow(1),
   fPt(1),
   fFilledPts(0),
+  fPooled(false),
+  fNQBins(1),
   fInitialized(false)
 {
 };
 
 GFWCumulant::~GFWCumulant()
 {
+  DestroyComplexVectorArray();
+};
+GFWCumulant::GFWCumulant(const GFWCumulant &other):
+  fQvector(0),
+  fQvectorF(0),
+  fPrecision(other.fPrecision),
+  fQBlock(0),
+  fTermHar(other.fTermHar),
+  fTermPow(other.fTermPow),
+  fTermIndex(other.fTermIndex),
+  fPtStride(other.fPtStride),
+  fUsed(other.fUsed),
+  fNEntries(other.fNEntries),
+  fN(other.fN),
+  fPow(other.fPow),
+  fPowVec(other.fPowVec),
+  fMaxPow(other.fMaxPow),
+  fPt(other.fPt),
+  fFilledPts(0),
+  fFilledBins(other.fFilledBins),
+  fPooled(other.fPooled),
+  fNQBins(other.fNQBins),
+  fBinSlot(other.fBinSlot),
+  fInitialized(false),
+  fSegPhi(other.fSegPhi),
+  fSegPhase(other.fSegPhase),
+  fSegSums(other.fSegSums),
+  fSegFilled(other.fSegFilled)
+{
+  if(!other.fInitialized) return;
+  AllocateQs();
+  memcpy(GetQBlock(),other.GetQBlock(),GetQBytes());
+  memcpy(fFilledPts,other.fFilledPts,fPt*sizeof(bool));
+  fInitialized=true;
+};
+GFWCumulant::GFWCumulant(GFWCumulant &&other) noexcept:
+  GFWCumulant()
+{
+  swap(other);
+};
+GFWCumulant &GFWCumulant::operator=(GFWCumulant other) {
+  swap(other);
+  return *this;
+};
+void GFWCumulant::swap(GFWCumulant &other) noexcept {
+  std::swap(fQvector,other.fQvector);
+  std::swap(fQvectorF,other.fQvectorF);
+  std::swap(fPrecision,other.fPrecision);
+  std::swap(fQBlock,other.fQBlock);
+  fTermHar.swap(other.fTermHar);
+  fTermPow.swap(other.fTermPow);
+  fTermIndex.swap(other.fTermIndex);
+  std::swap(fPtStride,other.fPtStride);
+  std::swap(fUsed,other.fUsed);
+  std::swap(fNEntries,other.fNEntries);
+  std::swap(fN,other.fN);
+  std::swap(fPow,other.fPow);
+  fPowVec.swap(other.fPowVec);
+  std::swap(fMaxPow,other.fMaxPow);
+  std::swap(fPt,other.fPt);
+  std::swap(fFilledPts,other.fFilledPts);
+  fFilledBins.swap(other.fFilledBins);
+  std::swap(fPooled,other.fPooled);
+  std::swap(fNQBins,other.fNQBins);
+  fBinSlot.swap(other.fBinSlot);
+  std::swap(fInitialized,other.fInitialized);
+  fBatchOffsets.swap(other.fBatchOffsets);
+  fBatchPhi.swap(other.fBatchPhi);
+  fBatchWeight.swap(other.fBatchWeight);
+  fBatchSecondWeight.swap(other.fBatchSecondWeight);
+  fBatchAcc.swap(other.fBatchAcc);
+  fSegPhi.swap(other.fSegPhi);
+  fSegPhase.swap(other.fSegPhase);
+  fSegSums.swap(other.fSegSums);
+  fSegFilled.swap(other.fSegFilled);
 };
 void GFWCumulant::FillArray(int ptin, double phi, double weight, double SecondWeight) {
   if(!fInitialized)
     CreateComplexVectorArray(1,1,1);
   if(fPt==1) ptin=0; //If one bin, then just fill it straight; otherwise, if ptin is out-of-range, do not fill
   else if(ptin<0 || ptin>=fPt) return;
-  fFilledPts[ptin] = true;
-  for(int lN = 0; lN<fN; lN++) {
-    double lSin = sin(lN*phi); //No need to recalculate for each power
-    double lCos = cos(lN*phi); //No need to recalculate for each power
-    for(int lPow=0; lPow<PW(lN); lPow++) {
-      double lPrefactor = 0;
-      //Dont calculate it twice; multiplication is cheaper that power
-      //Also, if second weight is specified, then keep the first weight with power no more than 1, and us the other weight otherwise
-      //this is important when POIs are a subset of REFs and have different weights than REFs
-      if(SecondWeight>0 && lPow>1) lPrefactor = pow(SecondWeight, lPow-1)*weight;
-      else lPrefactor = pow(weight,lPow);
-      double qsin = lPrefactor * lSin;
-      double qcos = lPrefactor * lCos;
-      fQvector[ptin][lN][lPow]+=complex<double>(qcos,qsin);
-    };
+  int lOffset = GetFillOffset(ptin);
+  if(fQvectorF) FillSingle(fQvectorF+lOffset,phi,weight,SecondWeight);
+  else FillSingle(fQvector+lOffset,phi,weight,SecondWeight);
+  Inc();
+};
+void GFWCumulant::FillArray(int nTracks, const int *ptin, const double *phi, const double *weight, const double *SecondWeight) {
+  if(!fInitialized)
+    CreateComplexVectorArray(1,1,1);
+  if(nTracks<1) return;
+  if(fPt==1 || !ptin) { //Single pT bin, so fill everything straight
+    FillBatchAt(GetFillOffset(0),nTracks,phi,weight,SecondWeight);
+    fNEntries+=nTracks;
+    return;
+  };
+  //Otherwise, first group tracks by pT bin (counting sort), so that each bin is filled with a contiguous batch. Out-of-range tracks are dropped
+  fBatchOffsets.assign(fPt+1,0);
+  for(int i=0;i<nTracks;i++) if(ptin[i]>=0 && ptin[i]<fPt) fBatchOffsets[ptin[i]+1]++;
+  for(int i=0;i<fPt;i++) fBatchOffsets[i+1]+=fBatchOffsets[i];
+  int nAccepted = fBatchOffsets[fPt];
+  fBatchPhi.resize(nAccepted);
+  fBatchWeight.resize(nAccepted);
+  fBatchSecondWeight.resize(SecondWeight?nAccepted:0);
+  for(int i=0;i<nTracks;i++) {
+    if(ptin[i]<0 || ptin[i]>=fPt) continue;
+    int lInd = fBatchOffsets[ptin[i]]++;
+    fBatchPhi[lInd] = phi[i];
+    fBatchWeight[lInd] = weight[i];
+    if(SecondWeight) fBatchSecondWeight[lInd] = SecondWeight[i];
+  };
+  //Offsets are now shifted by one bin, i.e. fBatchOffsets[i] is the end of bin i
+  for(int i=0;i<fPt;i++) {
+    int lStart = i?fBatchOffsets[i-1]:0;
+    int lN = fBatchOffsets[i]-lStart;
+    if(!lN) continue;
+    FillBatchAt(GetFillOffset(i),lN,fBatchPhi.data()+lStart,fBatchWeight.data()+lStart,SecondWeight?fBatchSecondWeight.data()+lStart:0);
+  };
+  fNEntries+=nAccepted;
+};
+void GFWCumulant::FillSegment(int ptin, int segment, double weight, double SecondWeight) {
+  if(!fInitialized)
+    CreateComplexVectorArray(1,1,1);
+  int nSegments = (int)fSegPhi.size();
+  if(segment<0 || segment>=nSegments) return;
+  if(fPt==1) ptin=0; //As in FillArray
+  else if(ptin<0 || ptin>=fPt) return;
+  if(!fMaxPow) { GetFillOffset(ptin); Inc(); return; }; //No terms are stored (e.g. sparse region that no configuration reads), so only the entry is counted, as in FillArray
+  if(fSegSums.empty()) fSegSums.assign((size_t)fPt*nSegments*fMaxPow,0.);
+  int lInd = ptin*nSegments+segment;
+  double *lSums = fSegSums.data()+(size_t)lInd*fMaxPow;
+  if(lSums[0]==0) fSegFilled.push_back(lInd);
+  const double lMult = (SecondWeight>0)?SecondWeight:weight;
+  double lPrefactor = 1;
+  for(int lPow=0;lPow<fMaxPow;lPow++) {
+    lSums[lPow]+=lPrefactor;
+    lPrefactor*=(lPow?lMult:weight);
   };
   Inc();
 };
+void GFWCumulant::FlushSegments() {
+  if(fSegFilled.empty()) return;
+  int nSegments = (int)fSegPhi.size();
+  if((int)fSegPhase.size()!=nSegments*fN) {
+    fSegPhase.resize(nSegments*fN);
+    for(int s=0;s<nSegments;s++) for(int n=0;n<fN;n++) fSegPhase[s*fN+n] = complex<double>(cos(n*fSegPhi[s]),sin(n*fSegPhi[s]));
+  };
+  for(int lInd: fSegFilled) {
+    int lSegment = lInd%nSegments;
+    int lOffset = GetFillOffset(lInd/nSegments);
+    double *lSums = fSegSums.data()+(size_t)lInd*fMaxPow;
+    const complex<double> *lPhase = fSegPhase.data()+lSegment*fN;
+    for(int lTerm=0;lTerm<fPtStride;lTerm++) {
+      complex<double> lQ = lSums[fTermPow[lTerm]]*lPhase[fTermHar[lTerm]];
+      if(fQvectorF) fQvectorF[lOffset+lTerm]+=complex<float>(lQ);
+      else fQvector[lOffset+lTerm]+=lQ;
+    };
+    std::fill(lSums,lSums+fMaxPow,0.);
+  };
+  fSegFilled.clear();
+};
+template<typename T> void GFWCumulant::FillSingle(complex<T> *lQ, double phi, double weight, double SecondWeight) {
+  //If second weight is specified, then keep the first weight with power no more than 1, and use the other weight otherwise
+  //this is important when POIs are a subset of REFs and have different weights than REFs
+  const double lMult = (SecondWeight>0)?SecondWeight:weight;
+  const double lCos1 = cos(phi);
+  const double lSin1 = sin(phi);
+  double lCos = 1, lSin = 0; //e^{i n phi}, starting from n=0
+  double lPrefactor = 1; //w*m^(p-1) for power p
+  int lN = 0, lPow = 0;
+  for(int lTerm = 0; lTerm<fPtStride; lTerm++) {
+    if(fTermHar[lTerm]!=lN) { //Next harmonic: advance the recurrence, and start powers from 0 again
+      for(;lN<fTermHar[lTerm];lN++) {
+        double lTmp = lCos*lCos1 - lSin*lSin1;
+        lSin = lSin*lCos1 + lCos*lSin1;
+        lCos = lTmp;
+      };
+      lPrefactor = 1;
+      lPow = 0;
+    };
+    for(;lPow<fTermPow[lTerm];lPow++) lPrefactor*=(lPow?lMult:weight);
+    lQ[lTerm]+=complex<T>(lPrefactor*lCos,lPrefactor*lSin);
+  };
+};
+template<typename T> void GFWCumulant::FillBatch(complex<T> *lQ, int nTracks, const double *phi, const double *weight, const double *SecondWeight) {
+  typedef GFWSimd S;
+  const int W = S::kWidth;
+  //Tracks that do not fill a complete register are done with the scalar kernel
+  int nVec = (fMaxPow<=kMaxBatchPow)?(nTracks/W)*W:0;
+  if(nVec) {
+    //Accumulators are laid out as [Q-vector index][re/im][lane] and summed over lanes only at the end
+    fBatchAcc.assign(2*W*fPtStride,0.);
+    double *lAcc = fBatchAcc.data();
+    alignas(64) double lCos1[W], lSin1[W], lMult[W];
+    S::V lPf[kMaxBatchPow];
+    for(int i=0;i<nVec;i+=W) {
+      for(int j=0;j<W;j++) {
+        lCos1[j] = cos(phi[i+j]);
+        lSin1[j] = sin(phi[i+j]);
+        lMult[j] = (SecondWeight && SecondWeight[i+j]>0)?SecondWeight[i+j]:weight[i+j];
+      };
+      const S::V vCos1 = S::load(lCos1);
+      const S::V vSin1 = S::load(lSin1);
+      const S::V vMult = S::load(lMult);
+      lPf[0] = S::set1(1.);
+      if(fMaxPow>1) lPf[1] = S::load(weight+i);
+      for(int lPow=2;lPow<fMaxPow;lPow++) lPf[lPow] = S::mul(lPf[lPow-1],vMult);
+      S::V vCos = S::set1(1.);
+      S::V vSin = S::set1(0.);
+      int lN = 0;
+      for(int lTerm=0;lTerm<fPtStride;lTerm++) {
+        for(;lN<fTermHar[lTerm];lN++) {
+          S::V vTmp = S::sub(S::mul(vCos,vCos1),S::mul(vSin,vSin1));
+          vSin = S::fmadd(vSin,vCos1,S::mul(vCos,vSin1));
+          vCos = vTmp;
+        };
+        double *lRe = lAcc + 2*W*lTerm;
+        double *lIm = lRe + W;
+        const S::V &vPf = lPf[fTermPow[lTerm]];
+        S::store(lRe,S::fmadd(vPf,vCos,S::load(lRe)));
+        S::store(lIm,S::fmadd(vPf,vSin,S::load(lIm)));
+      };
+    };
+    for(int i=0;i<fPtStride;i++) {
+      double lRe=0, lIm=0;
+      for(int j=0;j<W;j++) { lRe+=lAcc[2*W*i+j]; lIm+=lAcc[2*W*i+W+j]; };
+      lQ[i]+=complex<T>(lRe,lIm);
+    };
+  };
+  for(int i=nVec;i<nTracks;i++) FillSingle(lQ,phi[i],weight[i],SecondWeight?SecondWeight[i]:-1);
+};
+void GFWCumulant::FillBatchAt(int offset, int nTracks, const double *phi, const double *weight, const double *SecondWeight) {
+  if(fQvectorF) FillBatch(fQvectorF+offset,nTracks,phi,weight,SecondWeight);
+  else FillBatch(fQvector+offset,nTracks,phi,weight,SecondWeight);
+};
 void GFWCumulant::ResetQs() {
   if(!fNEntries) return; //If 0 entries, then no need to reset. Otherwise, if -1, then just initialized and need to set to 0.
-  for(int i=0; i<fPt; i++) {
-    fFilledPts[i] = false;
-    for(int lN=0;lN<fN;lN++) {
-      for(int lPow=0;lPow<PW(lN);lPow++) {
-  	       fQvector[i][lN][lPow] = fNullQ;
-      };
+  for(int lInd: fSegFilled) std::fill(fSegSums.begin()+(size_t)lInd*fMaxPow,fSegSums.begin()+(size_t)(lInd+1)*fMaxPow,0.);
+  fSegFilled.clear();
+  const size_t lBinBytes = GetQBytes()/fNQBins;
+  if(fNEntries<0 || (!fPooled && 2*fFilledBins.size()>(size_t)fPt)) { //Freshly allocated, or most of the bins are filled: a single memset is sufficient
+    memset(GetQBlock(),0,GetQBytes());
+    memset(fFilledPts,0,fPt*sizeof(bool));
+    if(fPooled) fBinSlot.assign(fPt,-1);
+  } else {
+    //Otherwise, only the bins that were filled are zeroed. With pooled storage, these are the first slots of the pool
+    if(fPooled) memset(GetQBlock(),0,fFilledBins.size()*lBinBytes);
+    for(int lBin: fFilledBins) {
+      if(!fPooled) memset(static_cast<char*>(GetQBlock())+lBin*lBinBytes,0,lBinBytes);
+      else fBinSlot[lBin] = -1;
+      fFilledPts[lBin] = false;
     };
   };
+  fFilledBins.clear();
   fNEntries=0;
 };
 void GFWCumulant::DestroyComplexVectorArray() {
   if(!fInitialized) return;
-  for(int l_n = 0; l_n<fN; l_n++) {
-    for(int i=0;i<fPt;i++) {
-      delete [] fQvector[i][l_n];
-    };
-  };
-  for(int i=0;i<fPt;i++) {
-    delete [] fQvector[i];
-  };
-  delete [] fQvector;
+  ::operator delete(fQBlock);
   delete [] fFilledPts;
+  fQBlock=0;
+  fQvector=0;
+  fQvectorF=0;
+  fFilledPts=0;
+  fFilledBins.clear();
+  fBinSlot.clear();
+  fSegPhase.clear();
+  fSegSums.clear();
+  fSegFilled.clear();
   fInitialized=false;
   fNEntries=-1;
 };
-
+void GFWCumulant::AllocateQs() {
+  //Allocate one block for all Q-vectors and align it manually, so that it starts at the beginning of a cache line
+  fQBlock = ::operator new(GetQBytes()+kQAlignment);
+  size_t lAddr = (reinterpret_cast<size_t>(fQBlock)+kQAlignment-1)&~(kQAlignment-1);
+  if(fPrecision==kFloat) fQvectorF = reinterpret_cast<complex<float>*>(lAddr);
+  else fQvector = reinterpret_cast<complex<double>*>(lAddr);
+  fFilledPts = new bool[fPt];
+};
+void GFWCumulant::GrowPool() {
+  //Pool is doubled (up to the number of bins). Filled slots are moved to the new block, and the rest is zeroed
+  int lNBins = std::min(2*fNQBins,fPt);
+  void *lOldBlock = fQBlock;
+  void *lOldQ = GetQBlock();
+  size_t lOldBytes = GetQBytes();
+  fNQBins = lNBins;
+  fQvector=0;
+  fQvectorF=0;
+  fQBlock = ::operator new(GetQBytes()+kQAlignment);
+  size_t lAddr = (reinterpret_cast<size_t>(fQBlock)+kQAlignment-1)&~(kQAlignment-1);
+  if(fPrecision==kFloat) fQvectorF = reinterpret_cast<complex<float>*>(lAddr);
+  else fQvector = reinterpret_cast<complex<double>*>(lAddr);
+  memcpy(GetQBlock(),lOldQ,lOldBytes);
+  memset(static_cast<char*>(GetQBlock())+lOldBytes,0,GetQBytes()-lOldBytes);
+  ::operator delete(lOldBlock);
+};
 void GFWCumulant::CreateComplexVectorArray(int N, int Pow, int Pt) {
   DestroyComplexVectorArray();
   vector<int> pwv;
@@ -79,29 +336,128 @@ void GFWCumulant::CreateComplexVectorArray(int N, int Pow, int Pt) {
   CreateComplexVectorArrayVarPower(N,pwv,Pt);
 };
 void GFWCumulant::CreateComplexVectorArrayVarPower(int N, vector<int> PowVec, int Pt) {
+  vector<pair<int, int> > lTerms;
+  for(int l_n=0;l_n<N;l_n++)
+    for(int l_p=0;l_p<PowVec[l_n];l_p++) lTerms.push_back(std::make_pair(l_n,l_p));
+  InitializeTerms(N,PowVec,lTerms,Pt);
+};
+void GFWCumulant::CreateComplexVectorArraySparse(vector<pair<int, int> > terms, int Pt) {
+  for(auto &term: terms) term.first = abs(term.first);
+  std::sort(terms.begin(),terms.end());
+  terms.erase(std::unique(terms.begin(),terms.end()),terms.end());
+  //Powers array that covers all the terms, so that PW() and the batched filling keep working
+  vector<int> lPowVec;
+  for(auto &term: terms) {
+    if(term.first>=(int)lPowVec.size()) lPowVec.resize(term.first+1,0);
+    lPowVec[term.first] = term.second+1;
+  };
+  InitializeTerms((int)lPowVec.size(),lPowVec,terms,Pt);
+};
+bool GFWCumulant::AddTerms(vector<pair<int, int> > terms) {
+  if(!fInitialized) { CreateComplexVectorArraySparse(terms,fPt); return true; };
+  bool isMissing=false;
+  for(auto &term: terms) if(!HasTerm(term.first,term.second)) { isMissing=true; break; };
+  if(!isMissing) return false;
+  FlushSegments(); //Sums are laid out by the old powers
+  for(int i=0;i<fPtStride;i++) terms.push_back(std::make_pair(fTermHar[i],fTermPow[i]));
+  //New arrays hold all the terms, with the same precision, storage and number of bins
+  GFWCumulant lNew;
+  lNew.SetPrecision(fPrecision);
+  lNew.SetPooled(fPooled);
+  lNew.CreateComplexVectorArraySparse(terms,fPt);
+  while(lNew.fNQBins<fNQBins) lNew.GrowPool();
+  //Q-vectors of filled bins are copied term by term. Bins are marked in the same order, so pooled storage keeps the same slots
+  for(int lBin: fFilledBins) {
+    int lOldOffset = (fPooled?fBinSlot[lBin]:lBin)*fPtStride;
+    int lNewOffset = lNew.GetFillOffset(lBin);
+    for(int i=0;i<fPtStride;i++) {
+      int lInd = lNewOffset+lNew.fTermIndex[fTermHar[i]*lNew.fMaxPow+fTermPow[i]];
+      if(fQvectorF) lNew.fQvectorF[lInd] = fQvectorF[lOldOffset+i];
+      else lNew.fQvector[lInd] = fQvector[lOldOffset+i];
+    };
+  };
+  lNew.fUsed = fUsed;
+  lNew.fNEntries = fNEntries;
+  lNew.fSegPhi = fSegPhi;
+  swap(lNew);
+  return true;
+};
+void GFWCumulant::AddBin(int ptbin, const GFWCumulant &plus, const GFWCumulant *minus) {
+  if(!fInitialized || !plus.fInitialized || !plus.fFilledPts[ptbin]) return;
+  if(minus && (!minus->fInitialized || !minus->fFilledPts[ptbin])) minus=0;
+  int lPlus = plus.GetBinOffset(ptbin);
+  int lMinus = minus?minus->GetBinOffset(ptbin):0;
+  int lOffset = GetFillOffset(ptbin);
+  for(int i=0;i<fPtStride;i++) {
+    complex<double> lQ = minus?plus.GetQ(lPlus+i)-minus->GetQ(lMinus+i):plus.GetQ(lPlus+i);
+    if(fQvectorF) fQvectorF[lOffset+i]+=complex<float>(lQ);
+    else fQvector[lOffset+i]+=lQ;
+  };
+};
+vector<pair<int, int> > GFWCumulant::GetTerms() const {
+  vector<pair<int, int> > retTerms(fPtStride);
+  for(int i=0;i<fPtStride;i++) retTerms[i] = std::make_pair(fTermHar[i],fTermPow[i]);
+  return retTerms;
+};
+bool GFWCumulant::GetBinQ(int ptbin, complex<double> *out) const {
+  if(!fInitialized || ptbin<0 || ptbin>=fPt || !fFilledPts[ptbin]) return false;
+  int lOffset = GetBinOffset(ptbin);
+  for(int i=0;i<fPtStride;i++) out[i] = GetQ(lOffset+i);
+  return true;
+};
+int GFWCumulant::SetBinQ(int ptbin, const vector<pair<int, int> > &terms, const complex<double> *values) {
+  if(!fInitialized || ptbin<0 || ptbin>=fPt) return (int)terms.size();
+  int lOffset = GetFillOffset(ptbin);
+  int nSet=0;
+  for(int i=0;i<(int)terms.size();i++) {
+    if(!HasTerm(terms[i].first,terms[i].second)) continue;
+    nSet++;
+    int lInd = lOffset+fTermIndex[terms[i].first*fMaxPow+terms[i].second];
+    if(fQvectorF) fQvectorF[lInd] = complex<float>(values[i]);
+    else fQvector[lInd] = values[i];
+  };
+  return fPtStride-nSet;
+};
+void GFWCumulant::InitializeTerms(int N, const vector<int> &PowVec, const vector<pair<int, int> > &terms, int Pt) {
   DestroyComplexVectorArray();
   fN=N;
   fPow=0;
   fPt=Pt;
-  fFilledPts = new bool[Pt];
+  fNQBins=fPooled?std::min(fPt,(int)kPoolInitialBins):fPt;
+  fBinSlot.assign(fPooled?fPt:0,-1);
+  fFilledBins.reserve(fPt);
   fPowVec = PowVec;
-  fQvector = new complex<double>**[fPt];
-  for(int i=0;i<fPt;i++) {
-    fQvector[i] = new complex<double>*[fN];
-  };
-  for(int l_n=0;l_n<fN;l_n++) {
-    for(int i=0;i<fPt;i++) {
-      fQvector[i][l_n] = new complex<double>[PW(l_n)];
-    };
+  fMaxPow = 0;
+  for(int lPow: fPowVec) fMaxPow = (lPow>fMaxPow)?lPow:fMaxPow;
+  //Terms are expected to be sorted by harmonic, then power
+  fPtStride = (int)terms.size();
+  fTermHar.resize(fPtStride);
+  fTermPow.resize(fPtStride);
+  fTermIndex.assign(fN*fMaxPow,-1);
+  for(int i=0;i<fPtStride;i++) {
+    fTermHar[i] = terms[i].first;
+    fTermPow[i] = terms[i].second;
+    fTermIndex[terms[i].first*fMaxPow+terms[i].second] = i;
   };
+  AllocateQs();
+  fNEntries=-1; //Force the reset of freshly allocated memory
   ResetQs();
   fInitialized=true;
 };
 complex<double> GFWCumulant::Vec(int n, int p, int ptbin) {
+  GFW_INSTR(GFWInstrument::CountVec());
   if(!fInitialized) return 0;
   if(ptbin>=fPt || ptbin<0) ptbin=0;
-  if(n>=0) return fQvector[ptbin][n][p];
-  return conj(fQvector[ptbin][-n][p]);
+  int lN = (n>=0)?n:-n;
+  if(lN>=fN || p>=fMaxPow) { fMissedTerm=true; return fNullQ; };
+  int lInd = fTermIndex[lN*fMaxPow+p];
+  if(lInd<0) { fMissedTerm=true; return fNullQ; }; //Term is not stored
+  if(fPooled) {
+    ptbin = fBinSlot[ptbin];
+    if(ptbin<0) return fNullQ; //Bin is not filled, so it does not have Q-vectors
+  };
+  complex<double> lQ = fQvectorF?complex<double>(fQvectorF[ptbin*fPtStride+lInd]):fQvector[ptbin*fPtStride+lInd];
+  return (n>=0)?lQ:conj(lQ);
 };
 bool GFWCumulant::IsPtBinFilled(int ptb) {
    if(!fFilledPts) return false;
@@ -0,0 +1,94 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Event-parallel driver for GFW, see the header for details.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#include "GFWDriver.h"
+#include <thread>
+#include <algorithm>
+GFWDriver::GFWDriver(GFW *inGFW, int nThreads, long batchSize, int nSubsamples):
+  fNThreads(nThreads),
+  fBatchSize(batchSize>0?batchSize:1),
+  fNSubsamples(nSubsamples),
+  fAccumulator(inGFW,nSubsamples),
+  fNextBatch(0)
+{
+  if(fNThreads<=0) fNThreads = (int)std::thread::hardware_concurrency();
+  if(fNThreads<=0) fNThreads = 1;
+  //Clones share nothing with the original: regions, Q-vectors, and the compiled plan are all copied
+  fClones.reserve(fNThreads);
+  for(int i=0;i<fNThreads;i++) fClones.push_back(*inGFW);
+};
+GFWDriver::~GFWDriver() {
+};
+bool GFWDriver::PopBatch(BatchQueue *queues, int iThread, long &iBatch) {
+  while(true) {
+    long lNext;
+    {
+      std::lock_guard<std::mutex> lock(fMergeMutex);
+      lNext = fNextBatch;
+    }
+    long lLimit = lNext+(long)kPendingPerThread*fNThreads;
+    //First take from the front of our own queue, otherwise steal from the front of someone else's. Queues are sorted, so the
+    //batch that is merged next is always at the front of one of them, and is taken even if all the others are too far ahead
+    bool isEmpty = true;
+    for(int i=0;i<fNThreads;i++) {
+      BatchQueue &lQueue = queues[(iThread+i)%fNThreads];
+      std::lock_guard<std::mutex> lock(lQueue.mtx);
+      if(lQueue.batches.empty()) continue;
+      isEmpty = false;
+      if(lQueue.batches.front()>=lLimit) continue;
+      iBatch = lQueue.batches.front();
+      lQueue.batches.pop_front();
+      return true;
+    };
+    if(isEmpty) return false;
+    //All the remaining batches are too far ahead, so wait until the ones that are running are merged
+    std::unique_lock<std::mutex> lock(fMergeMutex);
+    fMergeCV.wait(lock,[&]() { return fNextBatch!=lNext; });
+  };
+};
+void GFWDriver::Worker(BatchQueue *queues, int iThread, long nEvents, FillFunction &fillEvent) {
+  GFW &lGFW = fClones[iThread];
+  GFWAccumulator lAcc(&lGFW,fNSubsamples);
+  long iBatch;
+  while(PopBatch(queues,iThread,iBatch)) {
+    lAcc.Reset();
+    long lLast = std::min(nEvents,(iBatch+1)*fBatchSize);
+    for(long iEvent=iBatch*fBatchSize;iEvent<lLast;iEvent++) {
+      lGFW.Clear();
+      fillEvent(lGFW,iEvent);
+      lAcc.Fill(&lGFW,fNSubsamples?(int)(iEvent%fNSubsamples):-1);
+    };
+    MergeBatch(iBatch,lAcc);
+  };
+};
+void GFWDriver::MergeBatch(long iBatch, GFWAccumulator &lAcc) {
+  //Batches are merged strictly in order; the ones that finish early wait in fPendingBatches
+  {
+    std::lock_guard<std::mutex> lock(fMergeMutex);
+    if(iBatch!=fNextBatch) { fPendingBatches[iBatch] = lAcc; return; };
+    fAccumulator.Merge(lAcc);
+    fNextBatch++;
+    for(auto itr=fPendingBatches.begin(); itr!=fPendingBatches.end() && itr->first==fNextBatch; itr=fPendingBatches.erase(itr)) {
+      fAccumulator.Merge(itr->second);
+      fNextBatch++;
+    };
+  }
+  fMergeCV.notify_all(); //Workers waiting for batches within reach
+};
+void GFWDriver::Run(long nEvents, FillFunction fillEvent) {
+  if(nEvents<1) return;
+  long nBatches = (nEvents+fBatchSize-1)/fBatchSize;
+  fNextBatch=0;
+  fPendingBatches.clear();
+  //Batches are dealt out in turn, so that the fronts of all the queues are close to the next batch to be merged
+  vector<BatchQueue> lQueues(fNThreads);
+  for(long i=0;i<nBatches;i++) lQueues[i%fNThreads].batches.push_back(i);
+  vector<std::thread> lThreads;
+  for(int i=1;i<fNThreads;i++) lThreads.push_back(std::thread(&GFWDriver::Worker,this,lQueues.data(),i,nEvents,std::ref(fillEvent)));
+  Worker(lQueues.data(),0,nEvents,fillEvent);
+  for(auto &thr: lThreads) thr.join();
+};
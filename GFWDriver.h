@@ -0,0 +1,57 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Event-parallel driver for GFW. A fully configured GFW (i.e. after CreateRegions) is cloned for each worker thread. Events are split into batches of fixed size,
+which are dealt out to the queues of workers in turn. Workers pull from their own queues and steal from others when they run out. Each batch is accumulated
+separately, and batches are merged in order, so that the results do not depend on the number of threads or the scheduling. Queues are taken from the front,
+and a worker only starts a batch that is less than kPendingPerThread*nThreads ahead of the next one to be merged (otherwise it waits), so that at most as many
+finished batches are kept in memory while a preceding one is still running.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWDRIVER__H
+#define GFWDRIVER__H
+#include "GFW.h"
+#include "GFWAccumulator.h"
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+using std::vector;
+using std::map;
+class GFWDriver {
+ public:
+  //Called for each event with a GFW that has already been cleared. Has to be thread safe, i.e. only read shared data
+  typedef std::function<void(GFW &gfw, long iEvent)> FillFunction;
+  //nThreads<=0 uses all available cores. Event iEvent goes to subsample iEvent%nSubsamples
+  GFWDriver(GFW *inGFW, int nThreads=0, long batchSize=1000, int nSubsamples=0);
+  ~GFWDriver();
+  void Run(long nEvents, FillFunction fillEvent);
+  //Results of all the events processed so far
+  GFWAccumulator &GetAccumulator() { return fAccumulator; };
+  double GetValue(int ind) { return fAccumulator.GetValue(ind); };
+  int GetNThreads() { return fNThreads; };
+  GFW *GetGFW(int iThread) { return &fClones[iThread]; };
+  static const int kPendingPerThread = 2;
+ protected:
+  struct BatchQueue {
+    std::mutex mtx;
+    std::deque<long> batches;
+  };
+  int fNThreads;
+  long fBatchSize;
+  int fNSubsamples;
+  vector<GFW> fClones;
+  GFWAccumulator fAccumulator;
+  //Batches that are done but cannot be merged yet, because some of the preceding ones are still running
+  std::mutex fMergeMutex;
+  std::condition_variable fMergeCV; //Notified when fNextBatch advances
+  map<long, GFWAccumulator> fPendingBatches;
+  long fNextBatch; //Next batch to be merged
+  bool PopBatch(BatchQueue *queues, int iThread, long &iBatch);
+  void Worker(BatchQueue *queues, int iThread, long nEvents, FillFunction &fillEvent);
+  void MergeBatch(long iBatch, GFWAccumulator &lAcc);
+};
+#endif
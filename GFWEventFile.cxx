@@ -0,0 +1,209 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Compact binary (columnar) event format, see the header for details.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#include "GFWEventFile.h"
+#include <cstring>
+#include <climits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+namespace {
+  const char kFileMagic[8] = {'G','F','W','E','V','E','N','T'};
+  const char kBlockMagic[8] = {'G','F','W','B','L','O','C','K'};
+  const uint32_t kVersion = 1;
+  const uint32_t kHasSecondWeight = 1;
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t nEvents;
+    uint64_t nTracks;
+  };
+  struct BlockHeader {
+    char magic[8];
+    uint32_t nEvents;
+    uint32_t unused;
+    uint64_t nTracks;
+    uint64_t size;
+  };
+}
+GFWEventWriter::GFWEventWriter():
+  fFile(0),
+  fIsOk(true),
+  fStoreSecondWeight(false),
+  fTracksPerBlock(1<<20),
+  fNEvents(0),
+  fNTracks(0)
+{
+};
+GFWEventWriter::~GFWEventWriter() {
+  Close();
+};
+bool GFWEventWriter::Open(string fileName, bool storeSecondWeight, long tracksPerBlock) {
+  Close();
+  fFile = fopen(fileName.c_str(),"wb");
+  if(!fFile) { printf("Could not open %s for writing!\n",fileName.c_str()); return false; };
+  fFileName = fileName;
+  fIsOk = true;
+  fStoreSecondWeight = storeSecondWeight;
+  fTracksPerBlock = (tracksPerBlock>0)?tracksPerBlock:1;
+  fNEvents=0;
+  fNTracks=0;
+  fOffsets.assign(1,0);
+  //Header is rewritten with the totals when closing
+  FileHeader lHeader;
+  memcpy(lHeader.magic,kFileMagic,8);
+  lHeader.version = kVersion;
+  lHeader.flags = fStoreSecondWeight?kHasSecondWeight:0;
+  lHeader.nEvents = 0;
+  lHeader.nTracks = 0;
+  Write(&lHeader,sizeof(lHeader),1);
+  return fIsOk;
+};
+void GFWEventWriter::AddEvent(int nTracks, const double *eta, const int *ptin, const double *phi, const double *weight, const int *mask, const double *secondWeight) {
+  if(!fFile) return;
+  fEta.insert(fEta.end(),eta,eta+nTracks);
+  fPhi.insert(fPhi.end(),phi,phi+nTracks);
+  fWeight.insert(fWeight.end(),weight,weight+nTracks);
+  if(fStoreSecondWeight) {
+    if(secondWeight) fSecondWeight.insert(fSecondWeight.end(),secondWeight,secondWeight+nTracks);
+    else fSecondWeight.resize(fSecondWeight.size()+nTracks,-1);
+  };
+  fPtBin.insert(fPtBin.end(),ptin,ptin+nTracks);
+  fMask.insert(fMask.end(),mask,mask+nTracks);
+  fOffsets.push_back(fOffsets.back()+nTracks);
+  fNEvents++;
+  fNTracks+=nTracks;
+  if((long)fEta.size()>=fTracksPerBlock) FlushBlock();
+};
+void GFWEventWriter::FlushBlock() {
+  if(fOffsets.size()<2) return;
+  uint64_t nTracks = fEta.size();
+  BlockHeader lHeader;
+  memcpy(lHeader.magic,kBlockMagic,8);
+  lHeader.nEvents = (uint32_t)(fOffsets.size()-1);
+  lHeader.unused = 0;
+  lHeader.nTracks = nTracks;
+  lHeader.size = sizeof(lHeader) + fOffsets.size()*sizeof(uint64_t) + nTracks*((fStoreSecondWeight?4:3)*sizeof(double)+2*sizeof(int32_t));
+  //Ints are at the end, so pad the block to keep the next one aligned
+  uint64_t lPadding = (8-lHeader.size%8)%8;
+  lHeader.size+=lPadding;
+  Write(&lHeader,sizeof(lHeader),1);
+  Write(fOffsets.data(),sizeof(uint64_t),fOffsets.size());
+  Write(fEta.data(),sizeof(double),nTracks);
+  Write(fPhi.data(),sizeof(double),nTracks);
+  Write(fWeight.data(),sizeof(double),nTracks);
+  if(fStoreSecondWeight) Write(fSecondWeight.data(),sizeof(double),nTracks);
+  Write(fPtBin.data(),sizeof(int32_t),nTracks);
+  Write(fMask.data(),sizeof(int32_t),nTracks);
+  const char lZeros[8] = {0,0,0,0,0,0,0,0};
+  Write(lZeros,1,lPadding);
+  fOffsets.assign(1,0);
+  fEta.clear(); fPhi.clear(); fWeight.clear(); fSecondWeight.clear(); fPtBin.clear(); fMask.clear();
+};
+void GFWEventWriter::Write(const void *ptr, size_t size, size_t count) {
+  if(!count || fwrite(ptr,size,count,fFile)==count) return;
+  if(fIsOk) printf("Could not write to %s!\n",fFileName.c_str());
+  fIsOk = false;
+};
+bool GFWEventWriter::Close() {
+  if(!fFile) return true;
+  FlushBlock();
+  FileHeader lHeader;
+  memcpy(lHeader.magic,kFileMagic,8);
+  lHeader.version = kVersion;
+  lHeader.flags = fStoreSecondWeight?kHasSecondWeight:0;
+  lHeader.nEvents = fNEvents;
+  lHeader.nTracks = fNTracks;
+  if(fseek(fFile,0,SEEK_SET)) { printf("Could not write the header of %s!\n",fFileName.c_str()); fIsOk=false; }
+  else Write(&lHeader,sizeof(lHeader),1);
+  if(fclose(fFile) && fIsOk) { printf("Could not write to %s!\n",fFileName.c_str()); fIsOk=false; };
+  fFile=0;
+  return fIsOk;
+};
+GFWEventReader::GFWEventReader():
+  fData(0),
+  fSize(0),
+  fNTracks(0)
+{
+};
+GFWEventReader::~GFWEventReader() {
+  Close();
+};
+bool GFWEventReader::Open(string fileName) {
+  Close();
+  int fd = open(fileName.c_str(),O_RDONLY);
+  if(fd<0) { printf("Could not open %s!\n",fileName.c_str()); return false; };
+  struct stat lStat;
+  if(fstat(fd,&lStat)<0 || lStat.st_size<(off_t)sizeof(FileHeader)) { printf("%s is not a GFW event file!\n",fileName.c_str()); ::close(fd); return false; };
+  fSize = lStat.st_size;
+  void *lMap = mmap(0,fSize,PROT_READ,MAP_PRIVATE,fd,0);
+  ::close(fd);
+  if(lMap==MAP_FAILED) { printf("Could not map %s to memory!\n",fileName.c_str()); fSize=0; return false; };
+  fData = (const char*)lMap;
+  madvise(lMap,fSize,MADV_SEQUENTIAL);
+  const FileHeader *lHeader = (const FileHeader*)fData;
+  if(memcmp(lHeader->magic,kFileMagic,8) || lHeader->version!=kVersion) { printf("%s is not a GFW event file (or has a different version)!\n",fileName.c_str()); Close(); return false; };
+  //Index all the events. Headers of blocks are not trusted: a block has to hold all its columns within the file, and the offsets of its events have
+  //to be in order and within the block, so that GetEvent never reads beyond the mapped file
+  bool hasSecondWeight = lHeader->flags&kHasSecondWeight;
+  uint64_t lTrackSize = (hasSecondWeight?4:3)*sizeof(double)+2*sizeof(int32_t);
+  size_t lPos = sizeof(FileHeader);
+  while(lPos+sizeof(BlockHeader)<=fSize) {
+    const BlockHeader *lBlock = (const BlockHeader*)(fData+lPos);
+    uint64_t lLeft = fSize-lPos;
+    bool isValid = !memcmp(lBlock->magic,kBlockMagic,8) && lBlock->size<=lLeft && lBlock->size%8==0 && lBlock->nTracks<=lLeft/lTrackSize;
+    if(isValid) isValid = lBlock->size >= sizeof(BlockHeader)+((uint64_t)lBlock->nEvents+1)*sizeof(uint64_t)+lBlock->nTracks*lTrackSize;
+    if(isValid) {
+      const uint64_t *lOffsets = (const uint64_t*)(fData+lPos+sizeof(BlockHeader));
+      for(uint32_t i=0;i<=lBlock->nEvents && isValid;i++)
+        isValid = lOffsets[i]<=lBlock->nTracks && (!i || (lOffsets[i]>=lOffsets[i-1] && lOffsets[i]-lOffsets[i-1]<=(uint64_t)INT_MAX));
+    };
+    if(!isValid) { printf("Corrupted block in %s, only %li events are read!\n",fileName.c_str(),(long)fEvents.size()); break; };
+    for(uint32_t i=0;i<lBlock->nEvents;i++) fEvents.push_back(std::make_pair(fData+lPos,i));
+    fNTracks+=lBlock->nTracks;
+    lPos+=lBlock->size;
+  };
+  return true;
+};
+void GFWEventReader::Close() {
+  if(fData) munmap((void*)fData,fSize);
+  fData=0;
+  fSize=0;
+  fNTracks=0;
+  fEvents.clear();
+};
+bool GFWEventReader::GetEvent(long iEvent, Event &ev) {
+  if(iEvent<0 || iEvent>=(long)fEvents.size()) return false;
+  const char *lBlockPtr = fEvents[iEvent].first;
+  const BlockHeader *lBlock = (const BlockHeader*)lBlockPtr;
+  bool hasSecondWeight = ((const FileHeader*)fData)->flags&kHasSecondWeight;
+  uint64_t nTracks = lBlock->nTracks;
+  const uint64_t *lOffsets = (const uint64_t*)(lBlockPtr+sizeof(BlockHeader));
+  const double *lEta = (const double*)(lOffsets+lBlock->nEvents+1);
+  const double *lPhi = lEta+nTracks;
+  const double *lWeight = lPhi+nTracks;
+  const double *lSecondWeight = hasSecondWeight?lWeight+nTracks:0;
+  const int32_t *lPtBin = (const int32_t*)(lWeight+(hasSecondWeight?2:1)*nTracks);
+  const int32_t *lMask = lPtBin+nTracks;
+  uint64_t lFirst = lOffsets[fEvents[iEvent].second];
+  ev.nTracks = (int)(lOffsets[fEvents[iEvent].second+1]-lFirst);
+  ev.eta = lEta+lFirst;
+  ev.phi = lPhi+lFirst;
+  ev.weight = lWeight+lFirst;
+  ev.secondWeight = lSecondWeight?lSecondWeight+lFirst:0;
+  ev.ptin = lPtBin+lFirst;
+  ev.mask = lMask+lFirst;
+  return true;
+};
+bool GFWEventReader::Fill(GFW &inGFW, long iEvent) {
+  Event ev;
+  if(!GetEvent(iEvent,ev)) return false;
+  inGFW.Fill(ev.nTracks,ev.eta,ev.ptin,ev.phi,ev.weight,ev.mask,ev.secondWeight);
+  return true;
+};
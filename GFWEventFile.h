@@ -0,0 +1,64 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Compact binary (columnar) event format, to be read directly into the batched GFW::Fill. The file consists of a header and blocks of events:
+  Header (32 bytes): "GFWEVENT", uint32 version, uint32 flags (bit 0: secondWeight is stored), uint64 number of events, uint64 number of tracks
+  Block: 32-byte block header ("GFWBLOCK", uint32 events, uint32 unused, uint64 tracks, uint64 size of the block in bytes),
+         uint64 track offsets[events+1], followed by columns double eta[tracks], double phi[tracks], double weight[tracks], [double secondWeight[tracks]], int32 ptbin[tracks], int32 mask[tracks]
+Blocks are written once they reach a given number of tracks, so writing is done with bounded memory. The reader maps the file to memory, and events are
+returned as pointers to the columns, i.e. no data is copied. Numbers are stored in native byte order.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWEVENTFILE__H
+#define GFWEVENTFILE__H
+#include "GFW.h"
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <string>
+using std::vector;
+using std::string;
+class GFWEventWriter {
+ public:
+  GFWEventWriter();
+  ~GFWEventWriter();
+  bool Open(string fileName, bool storeSecondWeight=false, long tracksPerBlock=1<<20);
+  void AddEvent(int nTracks, const double *eta, const int *ptin, const double *phi, const double *weight, const int *mask, const double *secondWeight=0);
+  bool Close(); //Writes the remaining events and the totals in the header. Returns false if anything could not be written
+ protected:
+  FILE *fFile;
+  string fFileName;
+  bool fIsOk; //All writes so far succeeded
+  bool fStoreSecondWeight;
+  long fTracksPerBlock;
+  uint64_t fNEvents, fNTracks;
+  vector<uint64_t> fOffsets;
+  vector<double> fEta, fPhi, fWeight, fSecondWeight;
+  vector<int32_t> fPtBin, fMask;
+  void FlushBlock();
+  void Write(const void *ptr, size_t size, size_t count); //fwrite, reporting the first error
+};
+class GFWEventReader {
+ public:
+  struct Event {
+    int nTracks;
+    const double *eta, *phi, *weight, *secondWeight; //secondWeight is null if not stored
+    const int32_t *ptin, *mask;
+  };
+  GFWEventReader();
+  ~GFWEventReader();
+  bool Open(string fileName); //Blocks that are inconsistent with their headers (or the size of the file) end the reading, and the events before them are kept
+  void Close();
+  long GetNEvents() { return (long)fEvents.size(); };
+  long GetNTracks() { return fNTracks; };
+  bool GetEvent(long iEvent, Event &ev); //Can be called from multiple threads
+  bool Fill(GFW &inGFW, long iEvent); //Fills (but does not clear) GFW with all the tracks of the event
+ protected:
+  const char *fData;
+  size_t fSize;
+  long fNTracks;
+  //For each event: pointer to the block header and index of the event within the block
+  vector<pair<const char*, uint32_t> > fEvents;
+};
+#endif
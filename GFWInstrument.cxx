@@ -0,0 +1,128 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Optional instrumentation of the hot paths of GFW, see the header for details.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#include "GFWInstrument.h"
+thread_local long GFWInstrument::fNVec = 0;
+GFWInstrument::GFWInstrument():
+  fNPlan(0),
+  fNPlanVec(0),
+  fPlanTimeNs(0),
+  fNRecursive(0),
+  fConfigStartRecursive(0),
+  fConfigStartVec(0),
+  fPlanStartVec(0),
+  fConfigPlanNs(0),
+  fConfigPlanVec(0),
+  fInConfig(false)
+{
+};
+void GFWInstrument::Clear() {
+  fRegions.clear();
+  fConfigs.clear();
+  Reset();
+};
+void GFWInstrument::Reset() {
+  for(auto &reg: fRegions) { reg.NTracks=0; reg.NFillArray=0; };
+  for(auto &cfg: fConfigs) { cfg.NCalculate=0; cfg.NCalculateAll=0; cfg.NRecursive=0; cfg.NVec=0; cfg.TimeNs=0; };
+  fNPlan=0;
+  fNPlanVec=0;
+  fPlanTimeNs=0;
+  fInConfig=false;
+};
+void GFWInstrument::AddRegion(string name, int Nhar, int NpT, int NTerms, long QBytes) {
+  RegionStats lReg = {name, Nhar, NpT, NTerms, QBytes, 0, 0};
+  fRegions.push_back(lReg);
+};
+void GFWInstrument::UpdateRegion(int region, int Nhar, int NTerms, long QBytes) {
+  if(region<0 || region>=(int)fRegions.size()) return;
+  fRegions[region].Nhar = Nhar;
+  fRegions[region].NTerms = NTerms;
+  fRegions[region].QBytes = QBytes;
+};
+void GFWInstrument::AddConfig(string head) {
+  ConfigStats lCfg = {head, 0, 0, 0, 0, 0};
+  fConfigs.push_back(lCfg);
+};
+void GFWInstrument::Merge(const GFWInstrument &other) {
+  if(other.fRegions.size()!=fRegions.size() || other.fConfigs.size()!=fConfigs.size()) { printf("GFWInstrument::Merge: different regions or configurations, skipping\n"); return; };
+  for(size_t i=0;i<fRegions.size();i++) { fRegions[i].NTracks+=other.fRegions[i].NTracks; fRegions[i].NFillArray+=other.fRegions[i].NFillArray; };
+  for(size_t i=0;i<fConfigs.size();i++) {
+    fConfigs[i].NCalculate+=other.fConfigs[i].NCalculate;
+    fConfigs[i].NCalculateAll+=other.fConfigs[i].NCalculateAll;
+    fConfigs[i].NRecursive+=other.fConfigs[i].NRecursive;
+    fConfigs[i].NVec+=other.fConfigs[i].NVec;
+    fConfigs[i].TimeNs+=other.fConfigs[i].TimeNs;
+  };
+  fNPlan+=other.fNPlan;
+  fNPlanVec+=other.fNPlanVec;
+  fPlanTimeNs+=other.fPlanTimeNs;
+};
+void GFWInstrument::StartConfig() {
+  fInConfig=true;
+  fConfigPlanNs=0;
+  fConfigPlanVec=0;
+  fConfigStartRecursive=fNRecursive;
+  fConfigStartVec=fNVec;
+  fConfigStart=Clock::now();
+};
+void GFWInstrument::StopConfig(int iCfg, const string &head, bool fromCalculateAll) {
+  double lTime = std::chrono::duration<double, std::nano>(Clock::now()-fConfigStart).count();
+  fInConfig=false;
+  if(iCfg<0 || iCfg>=(int)fConfigs.size() || fConfigs[iCfg].Head!=head) {
+    for(iCfg=0;iCfg<(int)fConfigs.size();iCfg++) if(fConfigs[iCfg].Head==head) break;
+    if(iCfg==(int)fConfigs.size()) AddConfig(head);
+  };
+  ConfigStats &cfg = fConfigs[iCfg];
+  if(fromCalculateAll) cfg.NCalculateAll++;
+  else cfg.NCalculate++;
+  cfg.NRecursive+=fNRecursive-fConfigStartRecursive;
+  cfg.NVec+=fNVec-fConfigStartVec-fConfigPlanVec;
+  cfg.TimeNs+=lTime-fConfigPlanNs;
+};
+void GFWInstrument::StartPlan() {
+  fPlanStartVec=fNVec;
+  fPlanStart=Clock::now();
+};
+void GFWInstrument::StopPlan() {
+  double lTime = std::chrono::duration<double, std::nano>(Clock::now()-fPlanStart).count();
+  fNPlan++;
+  long lVec = fNVec-fPlanStartVec;
+  fNPlanVec+=lVec;
+  fPlanTimeNs+=lTime;
+  if(fInConfig) { fConfigPlanNs+=lTime; fConfigPlanVec+=lVec; };
+};
+void GFWInstrument::Print(FILE *fout) {
+  long lTotTracks=0, lTotBytes=0;
+  fprintf(fout,"%-20s %6s %6s %8s %12s %14s %14s\n","Region","Nhar","NpT","Terms","Q bytes","Tracks","FillArray");
+  for(auto &reg: fRegions) {
+    fprintf(fout,"%-20s %6i %6i %8i %12li %14li %14li\n",reg.Name.c_str(),reg.Nhar,reg.NpT,reg.NTerms,reg.QBytes,reg.NTracks,reg.NFillArray);
+    lTotTracks+=reg.NTracks;
+    lTotBytes+=reg.QBytes;
+  };
+  fprintf(fout,"%-20s %6s %6s %8s %12li %14li\n","Total","","","",lTotBytes,lTotTracks);
+  fprintf(fout,"\n%-20s %12s %12s %14s %14s %14s %14s\n","Config","Calculate","CalcAll","Recursion","Vec","Time [ms]","ns/call");
+  for(auto &cfg: fConfigs) {
+    long lCalls = cfg.NCalculate+cfg.NCalculateAll;
+    fprintf(fout,"%-20s %12li %12li %14li %14li %14.3f %14.1f\n",cfg.Head.c_str(),cfg.NCalculate,cfg.NCalculateAll,cfg.NRecursive,cfg.NVec,cfg.TimeNs*1e-6,lCalls?cfg.TimeNs/lCalls:0.);
+  };
+  fprintf(fout,"%-20s %12li %12s %14s %14li %14.3f %14.1f\n","(plan evaluation)",fNPlan,"","",fNPlanVec,fPlanTimeNs*1e-6,fNPlan?fPlanTimeNs/fNPlan:0.);
+};
+void GFWInstrument::PrintJSON(FILE *fout) {
+  fprintf(fout,"{\n  \"regions\": [\n");
+  for(size_t i=0;i<fRegions.size();i++) {
+    RegionStats &reg = fRegions[i];
+    fprintf(fout,"    {\"name\": \"%s\", \"nhar\": %i, \"npt\": %i, \"terms\": %i, \"q_bytes\": %li, \"tracks\": %li, \"fill_array_calls\": %li}%s\n",
+            reg.Name.c_str(),reg.Nhar,reg.NpT,reg.NTerms,reg.QBytes,reg.NTracks,reg.NFillArray,(i+1<fRegions.size())?",":"");
+  };
+  fprintf(fout,"  ],\n  \"configs\": [\n");
+  for(size_t i=0;i<fConfigs.size();i++) {
+    ConfigStats &cfg = fConfigs[i];
+    fprintf(fout,"    {\"head\": \"%s\", \"calculate_calls\": %li, \"calculate_all_calls\": %li, \"recursive_calls\": %li, \"vec_lookups\": %li, \"time_ns\": %.0f}%s\n",
+            cfg.Head.c_str(),cfg.NCalculate,cfg.NCalculateAll,cfg.NRecursive,cfg.NVec,cfg.TimeNs,(i+1<fConfigs.size())?",":"");
+  };
+  fprintf(fout,"  ],\n  \"plan\": {\"evaluations\": %li, \"vec_lookups\": %li, \"time_ns\": %.0f}\n}\n",fNPlan,fNPlanVec,fPlanTimeNs);
+};
@@ -0,0 +1,81 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Optional instrumentation of the hot paths of GFW, enabled by compiling with -DGFW_INSTRUMENT (see Makefile). Counts tracks and FillArray calls per region,
+and Calculate calls, RecursiveCorr calls, Vec() lookups and wall time per configuration. Evaluation of the compiled plan is shared by all configurations, so
+it is reported separately. Without GFW_INSTRUMENT, the GFW_INSTR(...) statements are removed, i.e. nothing is counted and there is no cost. The class itself
+is always defined (and GFW always holds one), so that the layout of GFW does not depend on the define, and code compiled with and without it can be mixed.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWINSTRUMENT__H
+#define GFWINSTRUMENT__H
+#ifdef GFW_INSTRUMENT
+#define GFW_INSTR(...) __VA_ARGS__
+#else
+#define GFW_INSTR(...)
+#endif
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <chrono>
+using std::vector;
+using std::string;
+class GFWInstrument {
+ public:
+  typedef std::chrono::steady_clock Clock;
+  struct RegionStats {
+    string Name;
+    int Nhar, NpT, NTerms; //NTerms: number of (harmonic, power) terms per pT bin
+    long QBytes;
+    long NTracks, NFillArray;
+  };
+  struct ConfigStats {
+    string Head;
+    long NCalculate, NCalculateAll, NRecursive, NVec;
+    double TimeNs;
+  };
+  GFWInstrument();
+  void Clear(); //Removes all regions and configurations
+  void Reset(); //Resets counters, but keeps regions and configurations
+  void AddRegion(string name, int Nhar, int NpT, int NTerms, long QBytes);
+  void UpdateRegion(int region, int Nhar, int NTerms, long QBytes); //After the region is extended by GFW::UpdateRegions
+  void AddConfig(string head);
+  void Merge(const GFWInstrument &other); //Adds counters of e.g. another thread (same regions and configurations)
+  void CountTracks(int region, long nTracks) { fRegions[region].NTracks+=nTracks; fRegions[region].NFillArray++; };
+  void CountRecursion() { fNRecursive++; };
+  static void CountVec() { fNVec++; }; //Called from GFWCumulant::Vec, counted per thread
+  //Calculation of a configuration is bracketed by StartConfig/StopConfig, counts in between are assigned to the configuration
+  void StartConfig();
+  //Configurations that were not compiled (e.g. fetched after CreateRegions) are added on the fly, and identified by their head
+  void StopConfig(int iCfg, const string &head, bool fromCalculateAll=false);
+  void StartPlan();
+  void StopPlan();
+  //Brackets the scope of a function with StartConfig/StopConfig, so that all the returns are covered
+  struct ConfigScope {
+    GFWInstrument &fInstr;
+    int fCfg;
+    const string &fHead;
+    bool fFromCalculateAll;
+    ConfigScope(GFWInstrument &instr, int iCfg, const string &head, bool fromCalculateAll=false): fInstr(instr), fCfg(iCfg), fHead(head), fFromCalculateAll(fromCalculateAll) { fInstr.StartConfig(); };
+    ~ConfigScope() { fInstr.StopConfig(fCfg,fHead,fFromCalculateAll); };
+  };
+  void Print(FILE *fout=stdout);
+  void PrintJSON(FILE *fout=stdout);
+  const vector<RegionStats> &GetRegions() { return fRegions; };
+  const vector<ConfigStats> &GetConfigs() { return fConfigs; };
+ protected:
+  vector<RegionStats> fRegions;
+  vector<ConfigStats> fConfigs;
+  long fNPlan, fNPlanVec;
+  double fPlanTimeNs;
+  long fNRecursive;
+  static thread_local long fNVec;
+  //State at the start of the current configuration/plan evaluation
+  Clock::time_point fConfigStart, fPlanStart;
+  long fConfigStartRecursive, fConfigStartVec, fPlanStartVec;
+  double fConfigPlanNs; //Time and lookups of plan evaluation during the current configuration, not assigned to it
+  long fConfigPlanVec;
+  bool fInConfig;
+};
+#endif
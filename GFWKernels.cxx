@@ -0,0 +1,69 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Closed-form kernels for the most common correlators, see the header for details.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#include "GFWKernels.h"
+bool GFWKernels::GetShape(const vector<int> &hars, int &h1, int &h2, int &na, int &nb) {
+  if(hars.empty() || (int)hars.size()>kMaxParticles) return false;
+  h1 = hars[0];
+  h2 = 0;
+  na = 0;
+  nb = 0;
+  for(int har: hars) {
+    if(har==h1) { na++; continue; };
+    if(!nb) h2 = har;
+    else if(har!=h2) return false; //More than two distinct harmonics
+    nb++;
+  };
+  return true;
+};
+complex<double> GFWKernels::Evaluate(GFWCumulant &cumulant, int ptbin, int h1, int h2, int na, int nb) {
+  switch(10*na+nb) {
+    case 10: return TwoHarmonicCorr<1,0>(cumulant,ptbin,h1,h2);
+    case 11: return TwoHarmonicCorr<1,1>(cumulant,ptbin,h1,h2);
+    case 12: return TwoHarmonicCorr<1,2>(cumulant,ptbin,h1,h2);
+    case 13: return TwoHarmonicCorr<1,3>(cumulant,ptbin,h1,h2);
+    case 14: return TwoHarmonicCorr<1,4>(cumulant,ptbin,h1,h2);
+    case 15: return TwoHarmonicCorr<1,5>(cumulant,ptbin,h1,h2);
+    case 16: return TwoHarmonicCorr<1,6>(cumulant,ptbin,h1,h2);
+    case 17: return TwoHarmonicCorr<1,7>(cumulant,ptbin,h1,h2);
+    case 20: return TwoHarmonicCorr<2,0>(cumulant,ptbin,h1,h2);
+    case 21: return TwoHarmonicCorr<2,1>(cumulant,ptbin,h1,h2);
+    case 22: return TwoHarmonicCorr<2,2>(cumulant,ptbin,h1,h2);
+    case 23: return TwoHarmonicCorr<2,3>(cumulant,ptbin,h1,h2);
+    case 24: return TwoHarmonicCorr<2,4>(cumulant,ptbin,h1,h2);
+    case 25: return TwoHarmonicCorr<2,5>(cumulant,ptbin,h1,h2);
+    case 26: return TwoHarmonicCorr<2,6>(cumulant,ptbin,h1,h2);
+    case 30: return TwoHarmonicCorr<3,0>(cumulant,ptbin,h1,h2);
+    case 31: return TwoHarmonicCorr<3,1>(cumulant,ptbin,h1,h2);
+    case 32: return TwoHarmonicCorr<3,2>(cumulant,ptbin,h1,h2);
+    case 33: return TwoHarmonicCorr<3,3>(cumulant,ptbin,h1,h2);
+    case 34: return TwoHarmonicCorr<3,4>(cumulant,ptbin,h1,h2);
+    case 35: return TwoHarmonicCorr<3,5>(cumulant,ptbin,h1,h2);
+    case 40: return TwoHarmonicCorr<4,0>(cumulant,ptbin,h1,h2);
+    case 41: return TwoHarmonicCorr<4,1>(cumulant,ptbin,h1,h2);
+    case 42: return TwoHarmonicCorr<4,2>(cumulant,ptbin,h1,h2);
+    case 43: return TwoHarmonicCorr<4,3>(cumulant,ptbin,h1,h2);
+    case 44: return TwoHarmonicCorr<4,4>(cumulant,ptbin,h1,h2);
+    case 50: return TwoHarmonicCorr<5,0>(cumulant,ptbin,h1,h2);
+    case 51: return TwoHarmonicCorr<5,1>(cumulant,ptbin,h1,h2);
+    case 52: return TwoHarmonicCorr<5,2>(cumulant,ptbin,h1,h2);
+    case 53: return TwoHarmonicCorr<5,3>(cumulant,ptbin,h1,h2);
+    case 60: return TwoHarmonicCorr<6,0>(cumulant,ptbin,h1,h2);
+    case 61: return TwoHarmonicCorr<6,1>(cumulant,ptbin,h1,h2);
+    case 62: return TwoHarmonicCorr<6,2>(cumulant,ptbin,h1,h2);
+    case 70: return TwoHarmonicCorr<7,0>(cumulant,ptbin,h1,h2);
+    case 71: return TwoHarmonicCorr<7,1>(cumulant,ptbin,h1,h2);
+    case 80: return TwoHarmonicCorr<8,0>(cumulant,ptbin,h1,h2);
+    default: return complex<double>(0,0);
+  };
+};
+void GFWKernels::AddTerms(TermSet &terms, int h1, int h2, int na, int nb) {
+  //Same as the Q-vectors taken in TwoHarmonicCorr
+  for(int i=0;i<=na;i++)
+    for(int j=0;j<=nb;j++)
+      if(i+j) terms.push_back(std::make_pair(i*h1+j*h2,i+j));
+};
@@ -0,0 +1,72 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Closed-form kernels for the most common correlators: up to 8 particles from a single region, with at most two distinct harmonics
+(e.g. {2 -2}, {2 2 -2 -2}, {2 2}, {2 3 -2 -3} is not covered, but {3 3 3 -3 -3 -3} and the normalization {0 0 0 0} are).
+For NA harmonics h1 and NB harmonics h2, the correlator is a sum over set partitions, where each block with i h1's and j h2's contributes
+(-1)^(i+j-1) (i+j-1)! Q(i*h1+j*h2, i+j). Partitions are grouped by block content, and the sum is built bottom-up as C[a][b] (a h1's and b h2's left):
+the block of the first remaining particle is picked, and the rest is taken from the table. With NA and NB known at compile time, all the loops are unrolled.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWKERNELS__H
+#define GFWKERNELS__H
+#include "GFWCumulant.h"
+#include "GFWPowerArray.h"
+#include <vector>
+#include <complex>
+using std::vector;
+using std::complex;
+class GFWKernels {
+ public:
+  static const int kMaxParticles = 8;
+  //Checks if a set of harmonics can be calculated with one of the kernels, and returns the two harmonics and their counts
+  static bool GetShape(const vector<int> &hars, int &h1, int &h2, int &na, int &nb);
+  static complex<double> Evaluate(GFWCumulant &cumulant, int ptbin, int h1, int h2, int na, int nb);
+  static void AddTerms(TermSet &terms, int h1, int h2, int na, int nb); //Adds the (harmonic, power) terms read by a kernel
+  template<int NA, int NB> static complex<double> TwoHarmonicCorr(GFWCumulant &cumulant, int ptbin, int h1, int h2) {
+    //All Q-vectors needed
+    complex<double> lQ[NA+1][NB+1];
+    for(int i=0;i<=NA;i++)
+      for(int j=0;j<=NB;j++)
+        if(i+j) lQ[i][j] = cumulant.Vec(i*h1+j*h2,i+j,ptbin);
+    complex<double> lC[NA+1][NB+1];
+    lC[0][0] = complex<double>(1,0);
+    for(int a=0;a<=NA;a++) {
+      for(int b=0;b<=NB;b++) {
+        if(!(a+b)) continue;
+        complex<double> lSum(0,0);
+        if(a) { //First particle is h1; its block also has i more h1's and j h2's
+          for(int i=0;i<a;i++)
+            for(int j=0;j<=b;j++)
+              lSum += (Binomial(a-1,i)*Binomial(b,j)*Moebius(1+i+j)) * lQ[1+i][j] * lC[a-1-i][b-j];
+        } else { //Only h2's are left
+          for(int j=0;j<b;j++)
+            lSum += (Binomial(b-1,j)*Moebius(1+j)) * lQ[0][1+j] * lC[0][b-1-j];
+        };
+        lC[a][b] = lSum;
+      };
+    };
+    return lC[NA][NB];
+  };
+ protected:
+  //Coefficients are tabulated, so that unrolled loops only read constants
+  static double Binomial(int n, int k) {
+    static const double lTab[kMaxParticles+1][kMaxParticles+1] = {
+      {1,0,0,0,0,0,0,0,0},
+      {1,1,0,0,0,0,0,0,0},
+      {1,2,1,0,0,0,0,0,0},
+      {1,3,3,1,0,0,0,0,0},
+      {1,4,6,4,1,0,0,0,0},
+      {1,5,10,10,5,1,0,0,0},
+      {1,6,15,20,15,6,1,0,0},
+      {1,7,21,35,35,21,7,1,0},
+      {1,8,28,56,70,56,28,8,1}};
+    return lTab[n][k];
+  };
+  static double Moebius(int n) { //(-1)^(n-1) (n-1)!
+    static const double lTab[kMaxParticles+1] = {0,1,-1,2,-6,24,-120,720,-5040};
+    return lTab[n];
+  };
+};
+#endif
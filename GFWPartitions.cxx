@@ -0,0 +1,98 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Correlators as sums over set partitions, see the header for details.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#include "GFWPartitions.h"
+#include <algorithm>
+GFWPartitions::Multiset GFWPartitions::MakeMultiset(const vector<int> &hars) {
+  Multiset retSet;
+  vector<int> lHars = hars;
+  std::sort(lHars.begin(),lHars.end());
+  for(int i=0;i<(int)lHars.size();i++) {
+    if(i && lHars[i]==lHars[i-1]) { retSet.Counts.back()++; continue; };
+    retSet.Values.push_back(lHars[i]);
+    retSet.Counts.push_back(1);
+  };
+  retSet.NStates=1;
+  for(int lCount: retSet.Counts) {
+    retSet.Strides.push_back(retSet.NStates);
+    retSet.NStates*=(lCount+1);
+  };
+  return retSet;
+};
+double GFWPartitions::Binomial(int n, int k) {
+  if(k<0 || k>n) return 0;
+  double retVal=1;
+  for(int i=1;i<=k;i++) retVal = retVal*(n-k+i)/i;
+  return retVal;
+};
+void GFWPartitions::GetBlocks(const Multiset &set, int index, bool withFirst, int extraHar, int extraPow, vector<Block> &blocks) {
+  blocks.clear();
+  int nValues = (int)set.Values.size();
+  vector<int> lCounts(nValues), lTaken(nValues,0);
+  int lFirst=-1;
+  for(int j=0;j<nValues;j++) {
+    lCounts[j] = (index/set.Strides[j])%(set.Counts[j]+1);
+    if(lFirst<0 && lCounts[j]) lFirst=j;
+  };
+  if(withFirst) {
+    if(lFirst<0) return; //Nothing left
+    lTaken[lFirst]=1;
+  };
+  //Loop over all sub-multisets (odometer over the counts taken of each harmonic)
+  while(true) {
+    Block lBlock = {extraHar, extraPow, 1., index};
+    for(int j=0;j<nValues;j++) {
+      lBlock.Har += lTaken[j]*set.Values[j];
+      lBlock.Pow += lTaken[j];
+      lBlock.Rest -= lTaken[j]*set.Strides[j];
+      lBlock.Coef *= (withFirst && j==lFirst)?Binomial(lCounts[j]-1,lTaken[j]-1):Binomial(lCounts[j],lTaken[j]);
+    };
+    if(lBlock.Pow>0) {
+      lBlock.Coef *= Moebius(lBlock.Pow);
+      blocks.push_back(lBlock);
+    };
+    int j=0;
+    for(;j<nValues;j++) {
+      if(lTaken[j]<lCounts[j]) { lTaken[j]++; break; };
+      lTaken[j] = (withFirst && j==lFirst)?1:0;
+    };
+    if(j==nValues) break;
+  };
+};
+complex<double> GFWPartitions::Evaluate(GFWCumulant *qpoi, GFWCumulant *qref, GFWCumulant *qol, int ptbin, const vector<int> &hars) {
+  if(hars.size()<2) return qpoi->Vec(hars.at(0),1,ptbin);
+  Multiset lSet = MakeMultiset(vector<int>(hars.begin()+2,hars.end()));
+  vector<Block> lBlocks;
+  //Partitions of the remaining particles into blocks from the reference, for each sub-multiset
+  vector<complex<double> > lRest(lSet.NStates);
+  lRest[0] = complex<double>(1,0);
+  for(int index=1;index<lSet.NStates;index++) {
+    GetBlocks(lSet,index,true,0,0,lBlocks);
+    complex<double> lSum(0,0);
+    for(auto &block: lBlocks) lSum += block.Coef*qref->Vec(block.Har,block.Pow,0)*lRest[block.Rest];
+    lRest[index] = lSum;
+  };
+  //Same, but with the block of the second particle in front
+  vector<complex<double> > lSecond(lSet.NStates);
+  for(int index=0;index<lSet.NStates;index++) {
+    GetBlocks(lSet,index,false,hars[1],1,lBlocks);
+    complex<double> lSum(0,0);
+    for(auto &block: lBlocks) lSum += block.Coef*qref->Vec(block.Har,block.Pow,ptbin)*lRest[block.Rest];
+    lSecond[index] = lSum;
+  };
+  //Block of the first particle, either without or with the second one
+  complex<double> retVal(0,0);
+  GetBlocks(lSet,lSet.NStates-1,false,hars[0],1,lBlocks);
+  for(auto &block: lBlocks) {
+    GFWCumulant *lReg = (block.Pow>1 && qol)?qol:qpoi;
+    retVal += block.Coef*lReg->Vec(block.Har,block.Pow,ptbin)*lSecond[block.Rest];
+  };
+  if(!qol) return retVal;
+  GetBlocks(lSet,lSet.NStates-1,false,hars[0]+hars[1],2,lBlocks);
+  for(auto &block: lBlocks) retVal += block.Coef*qol->Vec(block.Har,block.Pow,ptbin)*lRest[block.Rest];
+  return retVal;
+};
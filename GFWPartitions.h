@@ -0,0 +1,44 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Correlators of any order as sums over set partitions, where each block B of a partition contributes (-1)^(|B|-1) (|B|-1)! Q(sum of harmonics in B, |B|).
+Harmonics are treated as a multiset, so partitions that only differ by permutations of equal harmonics are grouped, and the sum is built bottom-up over
+sub-multisets (stored as counts of distinct harmonics, and encoded as a mixed-radix index), each of which is calculated only once. The number of terms
+then grows as a product of (count+1)^2 over distinct harmonics, while the recursion (GFW::RecursiveCorr) grows at least as the number of set partitions.
+The first two particles are kept apart, so that regions and pT bins are taken exactly as in the recursion:
+  - block of the first particle: POI if the particle is alone, otherwise overlap (or POI if the overlap is not defined), in the given pT bin
+  - block of the second particle: reference in the given pT bin, or overlap (0 if not defined) if the block also contains the first particle
+  - all other blocks: reference in the first pT bin
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWPARTITIONS__H
+#define GFWPARTITIONS__H
+#include "GFWCumulant.h"
+#include <vector>
+#include <complex>
+using std::vector;
+using std::complex;
+class GFWPartitions {
+ public:
+  struct Multiset {
+    vector<int> Values, Counts; //Distinct harmonics and their counts
+    vector<int> Strides; //Index of a sub-multiset is sum of Counts*Strides
+    int NStates; //Number of sub-multisets; the full set is NStates-1, and the empty one is 0
+  };
+  struct Block {
+    int Har, Pow; //Sum of harmonics and number of particles in the block
+    double Coef; //Number of ways to pick the block, times (-1)^(Pow-1) (Pow-1)!
+    int Rest; //Index of the sub-multiset that is left
+  };
+  static Multiset MakeMultiset(const vector<int> &hars);
+  //Blocks taken from the sub-multiset with a given index. With withFirst, the block contains the first of the remaining particles, so that each partition is
+  //counted only once. Otherwise, the block is made of extraPow distinguished particles with total harmonic extraHar, and any sub-multiset (including the empty one)
+  static void GetBlocks(const Multiset &set, int index, bool withFirst, int extraHar, int extraPow, vector<Block> &blocks);
+  //Same arguments as GFW::RecursiveCorr. qol can be null
+  static complex<double> Evaluate(GFWCumulant *qpoi, GFWCumulant *qref, GFWCumulant *qol, int ptbin, const vector<int> &hars);
+ protected:
+  static double Binomial(int n, int k);
+  static double Moebius(int n) { double retVal=(n%2)?1:-1; for(int i=2;i<n;i++) retVal*=i; return retVal; }; //(-1)^(n-1) (n-1)!
+};
+#endif
@@ -0,0 +1,135 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Evaluation plan for all the correlator configurations registered in GFW, see the header for details.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#include "GFWPlan.h"
+#include <cstdio>
+#include <cstring>
+GFWPlan::GFWPlan():
+  fNLeaves(0)
+{
+};
+void GFWPlan::Clear() {
+  fInstructions.clear();
+  fOperands.clear();
+  fScales.clear();
+  fProducts.clear();
+  fValues.clear();
+  fNLeaves=0;
+  fNodeIndex.clear();
+  fCfgOffset.clear();
+  fCfgNPt.clear();
+  fCfgNSub.clear();
+  fRoots.clear();
+};
+int GFWPlan::AddNode(const vector<int> &key, const Instruction &ins, const vector<pair<int, int> > &subtract) {
+  auto itr = fNodeIndex.find(key);
+  if(itr!=fNodeIndex.end()) return itr->second;
+  Instruction lIns = ins;
+  lIns.OpStart = (int)fOperands.size();
+  for(auto &sub: subtract) { fOperands.push_back(sub.first); fScales.push_back(sub.second); };
+  lIns.OpEnd = (int)fOperands.size();
+  fInstructions.push_back(lIns);
+  fValues.push_back(complex<double>(0,0));
+  int lInd = (int)fInstructions.size()-1;
+  fNodeIndex[key] = lInd;
+  return lInd;
+};
+int GFWPlan::AddLeaf(int reg, int har, int pow, int ptbin) {
+  Instruction lIns = {kLeaf, reg, har, pow, ptbin, 0, 0};
+  int nBefore = (int)fInstructions.size();
+  int lInd = AddNode(vector<int>{kLeaf, reg, har, pow, ptbin}, lIns, vector<pair<int, int> >{});
+  if((int)fInstructions.size()>nBefore) fNLeaves++;
+  return lInd;
+};
+int GFWPlan::AddMulSub(int a, int b, const vector<pair<int, int> > &subtract) {
+  vector<int> lKey = {kMulSub, a, b};
+  for(auto &sub: subtract) { lKey.push_back(sub.first); lKey.push_back(sub.second); };
+  Instruction lIns = {kMulSub, a, b, 0, 0, 0, 0};
+  return AddNode(lKey, lIns, subtract);
+};
+int GFWPlan::AddKernel(int reg, int ptbin, int h1, int h2, int na, int nb) {
+  Instruction lIns = {kKernel, reg, h1, h2, ptbin, 0, 0};
+  int lInd = AddNode(vector<int>{kKernel, reg, ptbin, h1, h2, na, nb}, lIns, vector<pair<int, int> >{});
+  //Kernel has no operands, so its range is (ab)used to store the number of particles
+  fInstructions[lInd].OpStart = na;
+  fInstructions[lInd].OpEnd = nb;
+  return lInd;
+};
+int GFWPlan::AddSumProd(const vector<Product> &products) {
+  vector<int> lKey = {kSumProd};
+  for(auto &prod: products) {
+    long long lCoef;
+    memcpy(&lCoef,&prod.Coef,sizeof(lCoef));
+    lKey.insert(lKey.end(),{prod.A, prod.B, (int)(lCoef>>32), (int)(lCoef&0xffffffff)});
+  };
+  auto itr = fNodeIndex.find(lKey);
+  if(itr!=fNodeIndex.end()) return itr->second;
+  Instruction lIns = {kSumProd, 0, 0, 0, 0, 0, 0};
+  int lStart = (int)fProducts.size();
+  fProducts.insert(fProducts.end(),products.begin(),products.end());
+  int lInd = AddNode(lKey, lIns, vector<pair<int, int> >{});
+  //Products are kept separately from the operands, so the range is set here
+  fInstructions[lInd].OpStart = lStart;
+  fInstructions[lInd].OpEnd = (int)fProducts.size();
+  return lInd;
+};
+void GFWPlan::SetNConfigs(int nConfigs) {
+  //Configurations that are already added are kept, so the plan can be extended with new ones
+  fCfgOffset.resize(nConfigs,-1);
+  fCfgNPt.resize(nConfigs,0);
+  fCfgNSub.resize(nConfigs,0);
+};
+void GFWPlan::AddConfig(int cfgIndex, int nPtBins, int nSubevents) {
+  fCfgOffset[cfgIndex] = (int)fRoots.size();
+  fCfgNPt[cfgIndex] = nPtBins;
+  fCfgNSub[cfgIndex] = nSubevents;
+  fRoots.resize(fRoots.size()+2*nPtBins*nSubevents,-1);
+};
+void GFWPlan::SetRoot(int cfgIndex, int ptbin, bool SetHarmsToZero, int subevent, int node) {
+  fRoots[fCfgOffset[cfgIndex] + (2*ptbin + SetHarmsToZero)*fCfgNSub[cfgIndex] + subevent] = node;
+};
+int GFWPlan::GetRoot(int cfgIndex, int ptbin, bool SetHarmsToZero, int subevent) {
+  if(cfgIndex<0 || cfgIndex>=(int)fCfgOffset.size() || fCfgOffset[cfgIndex]<0) return -1; //Config not compiled
+  if(ptbin<0 || ptbin>=fCfgNPt[cfgIndex]) return -1;
+  return fRoots[fCfgOffset[cfgIndex] + (2*ptbin + SetHarmsToZero)*fCfgNSub[cfgIndex] + subevent];
+};
+vector<TermSet> GFWPlan::GetTerms(int nRegions) {
+  vector<TermSet> retTerms(nRegions);
+  for(auto &ins: fInstructions) {
+    if(ins.Op==kLeaf) retTerms[ins.A].push_back(std::make_pair(ins.B,ins.Pow));
+    else if(ins.Op==kKernel) GFWKernels::AddTerms(retTerms[ins.A],ins.B,ins.Pow,ins.OpStart,ins.OpEnd);
+  };
+  for(auto &terms: retTerms) GFWPowerArray::NormalizeTermSet(terms);
+  return retTerms;
+};
+void GFWPlan::Evaluate(vector<GFWCumulant> &cumulants) {
+  //Nodes are added only after all their operands, so a single pass is sufficient
+  complex<double> *lVal = fValues.data();
+  for(int i=0;i<(int)fInstructions.size();i++) {
+    const Instruction &ins = fInstructions[i];
+    if(ins.Op==kLeaf) { lVal[i] = cumulants[ins.A].Vec(ins.B,ins.Pow,ins.PtBin); continue; };
+    if(ins.Op==kKernel) { lVal[i] = GFWKernels::Evaluate(cumulants[ins.A],ins.PtBin,ins.B,ins.Pow,ins.OpStart,ins.OpEnd); continue; };
+    if(ins.Op==kSumProd) {
+      complex<double> lSum(0,0);
+      for(int j=ins.OpStart;j<ins.OpEnd;j++) {
+        const Product &prod = fProducts[j];
+        lSum += (prod.B<0)?prod.Coef*lVal[prod.A]:prod.Coef*lVal[prod.A]*lVal[prod.B];
+      };
+      lVal[i] = lSum;
+      continue;
+    };
+    complex<double> formula = lVal[ins.A]*lVal[ins.B];
+    for(int j=ins.OpStart;j<ins.OpEnd;j++) {
+      if(fScales[j]==1) formula-=lVal[fOperands[j]];
+      else formula-=lVal[fOperands[j]]*(double)fScales[j];
+    };
+    lVal[i] = formula;
+  };
+};
+void GFWPlan::PrintStructure() {
+  printf("Evaluation plan: %i instructions, out of which %i Q-vector terms\n",GetNInstructions(),GetNLeaves());
+};
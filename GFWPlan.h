@@ -0,0 +1,70 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Evaluation plan for all the correlator configurations registered in GFW. The recursion of GFW::RecursiveCorr is expanded once (when regions are created),
+and each distinct term (Q-vector of a given region, harmonic, power, and pT bin, or a product of terms) becomes a single node of a flat instruction list.
+Terms shared within one configuration, between configurations, or between pT bins are thus evaluated only once per event.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWPLAN__H
+#define GFWPLAN__H
+#include "GFWCumulant.h"
+#include "GFWKernels.h"
+#include "GFWPowerArray.h"
+#include <vector>
+#include <complex>
+#include <map>
+#include <utility>
+using std::vector;
+using std::complex;
+using std::pair;
+using std::map;
+class GFWPlan {
+ public:
+  enum OpType_t {kLeaf=0, kMulSub=1, kKernel=2, kSumProd=3};
+  struct Instruction {
+    int Op; //kLeaf: value = Q(A, B, Pow, PtBin); kMulSub: value = v[A]*v[B] - sum_i Scales[i]*v[Operands[i]]; kKernel: closed-form correlator, see GFWKernels;
+            //kSumProd: value = sum_i Coef_i*v[A_i]*v[B_i] over Products (set partitions, see GFWPartitions)
+    int A, B; //kLeaf: region and harmonic; kMulSub: multiplied nodes; kKernel: region and first harmonic
+    int Pow, PtBin; //kLeaf: power and pT bin; kKernel: second harmonic and pT bin
+    int OpStart, OpEnd; //kMulSub: range of subtracted operands (and their scales); kKernel: number of first and second harmonics; kSumProd: range of products
+  };
+  struct Product {
+    int A, B; //Multiplied nodes. B<0 stands for 1
+    double Coef;
+  };
+  GFWPlan();
+  void Clear();
+  //Building the plan. Identical nodes are only added once, and the index of the existing one is returned
+  int AddLeaf(int reg, int har, int pow, int ptbin);
+  int AddMulSub(int a, int b, const vector<pair<int, int> > &subtract); //pair of (node, scale)
+  int AddKernel(int reg, int ptbin, int h1, int h2, int na, int nb);
+  int AddSumProd(const vector<Product> &products);
+  //Root nodes of each configuration, pT bin, and subevent. Normalization (harmonics set to 0) is stored separately
+  void SetNConfigs(int nConfigs);
+  void AddConfig(int cfgIndex, int nPtBins, int nSubevents);
+  void SetRoot(int cfgIndex, int ptbin, bool SetHarmsToZero, int subevent, int node);
+  int GetRoot(int cfgIndex, int ptbin, bool SetHarmsToZero, int subevent);
+  //Evaluation
+  void Evaluate(vector<GFWCumulant> &cumulants);
+  const complex<double> &GetValue(int node) { return fValues[node]; };
+  int GetNInstructions() { return (int)fInstructions.size(); };
+  int GetNLeaves() { return fNLeaves; };
+  vector<TermSet> GetTerms(int nRegions); //(Harmonic, power) terms read from each region by the plan, normalized with GFWPowerArray::NormalizeTermSet
+  bool IsEmpty() { return fInstructions.empty(); };
+  void PrintStructure();
+ protected:
+  vector<Instruction> fInstructions;
+  vector<int> fOperands;
+  vector<int> fScales;
+  vector<Product> fProducts;
+  vector<complex<double> > fValues;
+  int fNLeaves;
+  map<vector<int>, int> fNodeIndex; //! Lookup of existing nodes, only used when building the plan
+  //Roots: for config i, index = fCfgOffset[i] + (2*ptbin + SetHarmsToZero)*fCfgNSub[i] + subevent
+  vector<int> fCfgOffset, fCfgNPt, fCfgNSub;
+  vector<int> fRoots;
+  int AddNode(const vector<int> &key, const Instruction &ins, const vector<pair<int, int> > &subtract);
+};
+#endif
@@ -1,4 +1,7 @@
 #include "GFWPowerArray.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 int GFWPowerArray::getHighestHarmonic(const HarSet &inhar) {
   //Highest possible harmonic: sum of same-sign harmonics
   int maxPos=0, maxNeg=0;
@@ -27,7 +30,7 @@ void GFWPowerArray::FlushVectorToMaster(HarSet &masterVector, HarSet &comVec, co
 void GFWPowerArray::RecursiveFunction(HarSet &masterVector, HarSet hars, int offset, const int &MaxPower) {
   HarSet compVec = AddConstant(hars,offset);
   FlushVectorToMaster(masterVector, compVec, MaxPower);
-  for(int i=0;i<hars.size();i++) RecursiveFunction(masterVector,TrimVec(hars,i),offset+hars.at(i),MaxPower);;
+  for(int i=0;i<(int)hars.size();i++) RecursiveFunction(masterVector,TrimVec(hars,i),offset+hars.at(i),MaxPower);;
 };
 void GFWPowerArray::PrintVector(const HarSet &singleSet) {
   int vcSize = (int)singleSet.size();
@@ -36,7 +39,56 @@ void GFWPowerArray::PrintVector(const HarSet &singleSet) {
   for(int i=1;i<vcSize;i++) printf(", %i",singleSet[i]);
   printf("}\n");
 }
+void GFWPowerArray::SubsetFunction(HarSet &masterVector, const HarSet &hars, HarSet &maxSize) {
+  //Sums range from minus the sum of negative harmonics to the sum of positive ones, and are stored shifted by the former. -1 marks sums that cannot be reached
+  int sumNeg=0, sumPos=0;
+  for(int har: hars) if(har<0) sumNeg-=har; else sumPos+=har;
+  int nSums = sumNeg+sumPos+1;
+  maxSize.assign(nSums,-1);
+  maxSize[sumNeg] = 0; //Empty subset
+  //Each harmonic is added at most once: sums are updated in the direction of the harmonic, so that entries updated by it are not used again
+  for(int har: hars) {
+    if(har>0) { for(int i=nSums-1-har;i>=0;i--) if(maxSize[i]>=0 && maxSize[i]+1>maxSize[i+har]) maxSize[i+har] = maxSize[i]+1; }
+    else for(int i=-har;i<nSums;i++) if(maxSize[i]>=0 && maxSize[i]+1>maxSize[i+har]) maxSize[i+har] = maxSize[i]+1;
+  };
+  for(int i=0;i<nSums;i++) {
+    int absVal = abs(i-sumNeg);
+    if(masterVector.at(absVal) < maxSize[i]) masterVector.at(absVal) = maxSize[i];
+  };
+};
 HarSet GFWPowerArray::GetPowerArray(vector<HarSet> inHarmonics) {
+  //Order of harmonics does not matter, so permutations of the same set are only processed once
+  for(HarSet &singleSet: inHarmonics) sort(singleSet.begin(),singleSet.end());
+  sort(inHarmonics.begin(),inHarmonics.end());
+  inHarmonics.erase(unique(inHarmonics.begin(),inHarmonics.end()),inHarmonics.end());
+  //First, find maximum number of particle correlations ( = max power) and maximum (sum of) harmonics
+  int MaxHar=0;
+  int nMaxPart=0;
+  for(const HarSet &singleSet: inHarmonics) {
+    int harSum = getHighestHarmonic(singleSet);
+    MaxHar=harSum>MaxHar?harSum:MaxHar;
+  };
+  //Make a vector with MaxHar+1 entries (entry 0 for sum=0)
+  HarSet retVec = HarSet(MaxHar+1);
+  //Then find the largest subset for each sum of harmonics, for each set
+  HarSet lMaxSize;
+  for(const HarSet &singleSet: inHarmonics) {
+    int lNPart = (int)singleSet.size(); //Total number of particles correlated
+    SubsetFunction(retVec,singleSet,lMaxSize);
+    nMaxPart=(lNPart>nMaxPart)?lNPart:nMaxPart;
+  };
+  //Harmonic sum = 0 is a special case, as to calculate normalization, we set all harmonics to 0. This means that sum=0 power is the max number of harmonics/particles being correlated
+  if(retVec[0]<nMaxPart) retVec[0]=nMaxPart;
+  //Need an extra power ( = 0) for all non-zero powers
+  for(int &val:retVec) if(val!=0) val++;
+  return retVec;
+};
+void GFWPowerArray::NormalizeTermSet(TermSet &terms) {
+  for(auto &term: terms) term.first = abs(term.first);
+  sort(terms.begin(),terms.end());
+  terms.erase(unique(terms.begin(),terms.end()),terms.end());
+};
+HarSet GFWPowerArray::GetPowerArrayReference(vector<HarSet> inHarmonics) {
   //First, find maximum number of particle correlations ( = max power) and maximum (sum of) harmonics
   int MaxHar=0;
   int nMaxPart=0;
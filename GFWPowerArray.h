@@ -3,20 +3,30 @@
 #include <vector>
 #include <cmath>
 #include <string>
+#include <utility>
 using namespace std;
 using std::vector;
 using std::string;
 typedef vector<int> HarSet;
+typedef vector<pair<int, int> > TermSet; //Set of (harmonic, power) terms
+
 class GFWPowerArray {
  public:
    static HarSet GetPowerArray(vector<HarSet> inHarmonics);
+   static HarSet GetPowerArrayReference(vector<HarSet> inHarmonics); //Reference (factorial) implementation of the above, for validation
    static void PowerArrayTest();
+   //Sparse sets of terms: harmonics are taken as absolute values (negative ones are conjugates), and terms are sorted by harmonic, then power
+   static void NormalizeTermSet(TermSet &terms);
  private:
    static int getHighestHarmonic(const HarSet &inhar);
    static HarSet TrimVec(HarSet hars, int ind);
    static HarSet AddConstant(HarSet hars, int offset);
    static void FlushVectorToMaster(HarSet &masterVector, HarSet &comVec, const int &MaxPower);
-   static void RecursiveFunction(HarSet &masterVector, HarSet hars, int offset, const int &MaxPower);
+   static void RecursiveFunction(HarSet &masterVector, HarSet hars, int offset, const int &MaxPower); //Reference implementation, only used in GetPowerArrayReference
+   //Same result as RecursiveFunction: the term of the sum of any non-empty subset of the harmonics is needed with the power given by the size of the subset.
+   //For each sum, the largest subset is found in a single pass over the harmonics (as in a knapsack problem), instead of going over the subsets.
+   //maxSize is a scratch buffer, which is reused for all the sets
+   static void SubsetFunction(HarSet &masterVector, const HarSet &hars, HarSet &maxSize);
    static void PrintVector(const HarSet &singleSet);
 };
 #endif
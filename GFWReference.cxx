@@ -0,0 +1,109 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Brute-force reference for validation of GFW, see the header for details.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#include "GFWReference.h"
+GFWReference::GFWReference(GFW &gfw):
+  fGFW(gfw),
+  fNTracks(0)
+{
+  Clear();
+};
+void GFWReference::Clear() {
+  fRegionTracks.assign(fGFW.fRegions.size(),vector<Track>());
+  fNTracks=0;
+};
+void GFWReference::Fill(double eta, int ptin, double phi, double weight, int mask) {
+  if(fRegionTracks.size()!=fGFW.fRegions.size()) fRegionTracks.resize(fGFW.fRegions.size());
+  for(int i=0;i<(int)fGFW.fRegions.size();i++) {
+    const GFW::Region &reg = fGFW.fRegions[i];
+    if(!(reg.EtaMin<eta && eta<reg.EtaMax) || !(reg.BitMask&mask)) continue;
+    //Same as GFWCumulant::FillArray: with a single bin, everything goes into it; otherwise out-of-range tracks are dropped
+    int lBin = (reg.NpT==1)?0:fGFW.GetRegionBin(i,ptin);
+    if(lBin<0 || lBin>=reg.NpT) continue;
+    double lWeight = (reg.Weights<0)?weight:weight*fGFW.GetWeights(reg.Weights).Get(phi,eta,ptin);
+    fRegionTracks[i].push_back({fNTracks,lBin,phi,lWeight});
+  };
+  fNTracks++;
+};
+void GFWReference::Fill(int nTracks, const double *eta, const int *ptin, const double *phi, const double *weight, const int *mask) {
+  for(int i=0;i<nTracks;i++) Fill(eta[i],ptin[i],phi[i],weight[i],mask[i]);
+};
+void GFWReference::SumTuples(int iPart, complex<double> val, double norm, complex<double> &sumVal, double &sumNorm) {
+  if(iPart==(int)fTerms.size()) { sumVal+=val; sumNorm+=norm; return; };
+  const vector<complex<double> > &lTerms = fTerms[iPart];
+  for(int j=0;j<(int)fRefTracks.size();j++) {
+    const Track &trk = fRefTracks[j];
+    if(fUsed[trk.ID]) continue;
+    fUsed[trk.ID]=1;
+    SumTuples(iPart+1,val*lTerms[j],norm*trk.Weight,sumVal,sumNorm);
+    fUsed[trk.ID]=0;
+  };
+};
+void GFWReference::CalculateSubevent(const GFW::CorrConfig &corconf, int subevent, int ptbin, complex<double> &val, double &norm) {
+  val=0;
+  norm=0;
+  const vector<int> &lHars = corconf.Hars[subevent];
+  if(corconf.Regs[subevent].empty() || lHars.empty()) return;
+  int ptInd = fGFW.GetSubeventBin(corconf,subevent,ptbin);
+  int poi = corconf.Regs[subevent][0];
+  int ref = (corconf.Regs[subevent].size()>1)?corconf.Regs[subevent][1]:poi;
+  int ovl = corconf.Overlap[subevent];
+  auto RegionBin = [&](int reg) { return (fGFW.fRegions[reg].NpT==1)?0:ptInd; };
+  //Ref. tracks in the bin, with w*e^{i h phi} for each of the particles after the first
+  fRefTracks.clear();
+  int lRefBin = RegionBin(ref);
+  for(const Track &trk: fRegionTracks[ref]) if(trk.Bin==lRefBin) fRefTracks.push_back(trk);
+  if(fRefTracks.empty()) return; //As in GFW, the subevent is not filled without ref. tracks, even if they are not needed (a single POI particle)
+  int nPart = (int)lHars.size();
+  fTerms.assign(nPart,vector<complex<double> >());
+  for(int k=1;k<nPart;k++) for(const Track &trk: fRefTracks) fTerms[k].push_back(std::polar(trk.Weight,lHars[k]*trk.Phi));
+  //Tracks that cannot be both the first and one of the other particles
+  vector<char> lOverlap(fNTracks,0);
+  if(poi==ref) lOverlap.assign(fNTracks,1);
+  else if(ovl>-1) {
+    int lOvlBin = RegionBin(ovl);
+    for(const Track &trk: fRegionTracks[ovl]) if(trk.Bin==lOvlBin) lOverlap[trk.ID]=1;
+  };
+  fUsed.assign(fNTracks,0);
+  int lPoiBin = RegionBin(poi);
+  for(const Track &trk: fRegionTracks[poi]) {
+    if(trk.Bin!=lPoiBin) continue;
+    if(lOverlap[trk.ID]) fUsed[trk.ID]=1;
+    SumTuples(1,std::polar(trk.Weight,lHars[0]*trk.Phi),trk.Weight,val,norm);
+    fUsed[trk.ID]=0;
+  };
+};
+complex<double> GFWReference::Calculate(const GFW::CorrConfig &corconf, int ptbin, bool SetHarmsToZero) {
+  if(corconf.Regs.empty()) return complex<double>(0,0);
+  complex<double> retVal(1,0);
+  for(int i=0;i<(int)corconf.Regs.size();i++) {
+    complex<double> lVal;
+    double lNorm;
+    CalculateSubevent(corconf,i,ptbin,lVal,lNorm);
+    retVal *= SetHarmsToZero?complex<double>(lNorm,0):lVal;
+  };
+  return retVal;
+};
+void GFWReference::CalculateAll(pair<double, double> *out) {
+  const vector<GFW::CorrConfig> &lConfigs = fGFW.GetConfigs();
+  for(int iCfg=0;iCfg<(int)lConfigs.size();iCfg++) {
+    const GFW::CorrConfig &cfg = lConfigs[iCfg];
+    int lNpT = fGFW.GetConfigNpT(cfg);
+    for(int ptbin=0;ptbin<lNpT;ptbin++) {
+      complex<double> lVal(1,0);
+      double lNorm = 1;
+      for(int i=0;i<(int)cfg.Regs.size() && lNorm!=0;i++) {
+        complex<double> lSubVal;
+        double lSubNorm;
+        CalculateSubevent(cfg,i,ptbin,lSubVal,lSubNorm);
+        lVal*=lSubVal;
+        lNorm*=lSubNorm;
+      };
+      out[fGFW.GetOutputIndex(iCfg,ptbin)] = (lNorm!=0 && !cfg.Regs.empty())?std::make_pair(lVal.real()/lNorm,lNorm):std::make_pair(0.,0.);
+    };
+  };
+};
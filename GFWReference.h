@@ -0,0 +1,55 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Brute-force reference for validation of GFW: correlators are calculated as explicit sums over all tuples of distinct tracks (nested loops, O(M^n)),
+with the same regions, configurations and output layout as the GFW it is constructed from. Only meant for small events (e.g. tens of tracks per region).
+It only uses the public interface of GFW, and is not a part of libGFW.so: GFWReference.cxx is compiled together with the code that uses it (e.g. Validate).
+Semantics of a subevent "poi ref | ovl {h1 ... hn}" in (pT) bin b:
+  -- the first particle is a track of POI in bin b, the others are distinct tracks of ref. (in bin b, or in its only bin)
+  -- the first particle is also excluded from the others if POI and ref. are the same region, or if it is in the overlap region (in bin b)
+  -- each tuple contributes the product of w*e^{i h phi} of its tracks, and the normalization is the same sum with all harmonics set to 0
+Subevents of a configuration are multiplied, as in GFW, and a subevent without any ref. tracks is empty. Tracks are assigned to regions as in GFW::Fill
+(EtaMin < eta < EtaMax and a matching bit mask), weight tables of regions are applied, and bins on axes and in the configurations are selected as in GFW.
+The agreement is exact only where the Q-vector expansion of GFW is exact, i.e. if the overlap region contains exactly the tracks that are both in POI
+and ref., without second weights, and with reference regions that have a single bin (GFW takes ref. particles beyond the second from the first bin).
+Without an overlap region, GFW subtracts terms where a ref. particle coincides with the POI one for 3 or more particles (with Q-vectors of POI),
+while these are simply absent here, since a POI track is then never a ref. track.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWREFERENCE__H
+#define GFWREFERENCE__H
+#include "GFW.h"
+#include <vector>
+#include <complex>
+#include <utility>
+using std::vector;
+using std::complex;
+using std::pair;
+class GFWReference {
+ public:
+  GFWReference(GFW &gfw); //Regions, configurations and weight tables are taken from gfw when filling and calculating, so it must be initialized (CreateRegions) first
+  void Clear();
+  void Fill(double eta, int ptin, double phi, double weight, int mask);
+  void Fill(int nTracks, const double *eta, const int *ptin, const double *phi, const double *weight, const int *mask);
+  //Same as GFW::Calculate, i.e. the product over subevents (not normalized)
+  complex<double> Calculate(const GFW::CorrConfig &corconf, int ptbin, bool SetHarmsToZero);
+  //Same as GFW::CalculateAll, with the same layout of the output (value normalized by the weight, and the weight). Entries without any tuple are (0,0)
+  void CalculateAll(pair<double, double> *out);
+ protected:
+  struct Track {
+    int ID, Bin;
+    double Phi, Weight;
+  };
+  GFW &fGFW;
+  vector<vector<Track> > fRegionTracks; //Tracks of each region
+  int fNTracks; //Tracks filled in this event, used as IDs
+  //Sum over tuples of one subevent, with the normalization (harmonics set to 0) calculated in the same loop
+  void CalculateSubevent(const GFW::CorrConfig &corconf, int subevent, int ptbin, complex<double> &val, double &norm);
+  //Nested loops over the ref. particles from iPart on. fTerms holds w*e^{i h phi} of each ref. track for each particle
+  void SumTuples(int iPart, complex<double> val, double norm, complex<double> &sumVal, double &sumNorm);
+  vector<Track> fRefTracks; //! Ref. tracks of the current subevent and bin
+  vector<vector<complex<double> > > fTerms; //!
+  vector<char> fUsed; //! Per track ID
+};
+#endif
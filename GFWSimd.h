@@ -0,0 +1,68 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Minimal wrapper around SIMD registers of doubles, used by the batched Q-vector filling in GFWCumulant.
+The widest instruction set enabled at compile time is used (AVX-512, AVX2, SSE2), otherwise it falls back to plain doubles.
+To enable wider registers, compile with e.g. -mavx2 -mfma or -march=native.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWSIMD__H
+#define GFWSIMD__H
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if defined(__AVX512F__)
+struct GFWSimd {
+  typedef __m512d V;
+  static const int kWidth = 8;
+  static V load(const double *p) { return _mm512_loadu_pd(p); };
+  static void store(double *p, V a) { _mm512_storeu_pd(p,a); };
+  static V set1(double a) { return _mm512_set1_pd(a); };
+  static V add(V a, V b) { return _mm512_add_pd(a,b); };
+  static V sub(V a, V b) { return _mm512_sub_pd(a,b); };
+  static V mul(V a, V b) { return _mm512_mul_pd(a,b); };
+  static V fmadd(V a, V b, V c) { return _mm512_fmadd_pd(a,b,c); }; //a*b+c
+};
+#elif defined(__AVX2__)
+struct GFWSimd {
+  typedef __m256d V;
+  static const int kWidth = 4;
+  static V load(const double *p) { return _mm256_loadu_pd(p); };
+  static void store(double *p, V a) { _mm256_storeu_pd(p,a); };
+  static V set1(double a) { return _mm256_set1_pd(a); };
+  static V add(V a, V b) { return _mm256_add_pd(a,b); };
+  static V sub(V a, V b) { return _mm256_sub_pd(a,b); };
+  static V mul(V a, V b) { return _mm256_mul_pd(a,b); };
+#if defined(__FMA__)
+  static V fmadd(V a, V b, V c) { return _mm256_fmadd_pd(a,b,c); };
+#else
+  static V fmadd(V a, V b, V c) { return _mm256_add_pd(_mm256_mul_pd(a,b),c); };
+#endif
+};
+#elif defined(__SSE2__)
+struct GFWSimd {
+  typedef __m128d V;
+  static const int kWidth = 2;
+  static V load(const double *p) { return _mm_loadu_pd(p); };
+  static void store(double *p, V a) { _mm_storeu_pd(p,a); };
+  static V set1(double a) { return _mm_set1_pd(a); };
+  static V add(V a, V b) { return _mm_add_pd(a,b); };
+  static V sub(V a, V b) { return _mm_sub_pd(a,b); };
+  static V mul(V a, V b) { return _mm_mul_pd(a,b); };
+  static V fmadd(V a, V b, V c) { return _mm_add_pd(_mm_mul_pd(a,b),c); };
+};
+#else
+struct GFWSimd {
+  typedef double V;
+  static const int kWidth = 1;
+  static V load(const double *p) { return *p; };
+  static void store(double *p, V a) { *p = a; };
+  static V set1(double a) { return a; };
+  static V add(V a, V b) { return a+b; };
+  static V sub(V a, V b) { return a-b; };
+  static V mul(V a, V b) { return a*b; };
+  static V fmadd(V a, V b, V c) { return a*b+c; };
+};
+#endif
+#endif
@@ -0,0 +1,358 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Versioned binary format for the state of GFW, see the header for details.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#include "GFWStateFile.h"
+#include <cstring>
+namespace {
+  const char kFileMagic[8] = {'G','F','W','S','T','A','T','E'};
+  const uint32_t kVersion = 1;
+  //Tags and current versions of the records, indexed by GFWStateReader::Record_t. Versions of SETUP: 2 adds phi segments, 3 adds weight tables of the regions
+  const char kRecordTags[4][8] = {{0}, {'S','E','T','U','P',0,0,0}, {'Q','S','N','A','P',0,0,0}, {'A','C','C','U','M',0,0,0}};
+  const uint32_t kRecordVersions[4] = {0, 3, 1, 1};
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+  };
+  struct RecordHeader {
+    char tag[8];
+    uint32_t version;
+    uint32_t unused;
+    uint64_t size;
+  };
+  //Appends values to the payload
+  struct Packer {
+    vector<char> &buf;
+    template<typename T> void Put(const T &val) { const char *lPtr = reinterpret_cast<const char*>(&val); buf.insert(buf.end(),lPtr,lPtr+sizeof(T)); };
+    template<typename T> void PutArray(const T *vals, size_t n) { const char *lPtr = reinterpret_cast<const char*>(vals); buf.insert(buf.end(),lPtr,lPtr+n*sizeof(T)); };
+    void PutString(const string &str) { Put((uint32_t)str.size()); PutArray(str.data(),str.size()); };
+    void PutVector(const vector<int> &vec) { Put((uint32_t)vec.size()); for(int val: vec) Put((int32_t)val); };
+  };
+  //Reads values from the payload. Reading beyond its end sets fail, and then only zeros are returned
+  struct Unpacker {
+    const vector<char> &buf;
+    size_t pos;
+    bool fail;
+    bool Check(size_t n) { if(fail || pos+n>buf.size()) { fail=true; return false; }; return true; };
+    template<typename T> T Get() { T retVal{}; if(Check(sizeof(T))) { memcpy(&retVal,buf.data()+pos,sizeof(T)); pos+=sizeof(T); }; return retVal; };
+    template<typename T> void GetArray(T *vals, size_t n) { if(!Check(n*sizeof(T))) return; memcpy(vals,buf.data()+pos,n*sizeof(T)); pos+=n*sizeof(T); };
+    string GetString() { uint32_t n = Get<uint32_t>(); if(!Check(n)) return ""; string retStr(buf.data()+pos,n); pos+=n; return retStr; };
+    vector<int> GetVector() {
+      uint32_t n = Get<uint32_t>();
+      if(!Check((size_t)n*sizeof(int32_t))) return vector<int>{};
+      vector<int> retVec(n);
+      for(uint32_t i=0;i<n;i++) retVec[i] = Get<int32_t>();
+      return retVec;
+    };
+  };
+}
+GFWStateWriter::GFWStateWriter():
+  fFile(0),
+  fIsOk(true),
+  fNRecords(0)
+{
+};
+GFWStateWriter::~GFWStateWriter() {
+  Close();
+};
+bool GFWStateWriter::Open(string fileName) {
+  Close();
+  fFile = fopen(fileName.c_str(),"wb");
+  if(!fFile) { printf("Could not open %s for writing!\n",fileName.c_str()); return false; };
+  fFileName = fileName;
+  fIsOk = true;
+  fNRecords=0;
+  FileHeader lHeader;
+  memcpy(lHeader.magic,kFileMagic,8);
+  lHeader.version = kVersion;
+  lHeader.flags = 0;
+  Write(&lHeader,sizeof(lHeader),1);
+  return fIsOk;
+};
+bool GFWStateWriter::Close() {
+  if(!fFile) return true;
+  if(fclose(fFile) && fIsOk) { printf("Could not write to %s!\n",fFileName.c_str()); fIsOk=false; };
+  fFile=0;
+  return fIsOk;
+};
+void GFWStateWriter::Write(const void *ptr, size_t size, size_t count) {
+  if(!count || fwrite(ptr,size,count,fFile)==count) return;
+  if(fIsOk) printf("Could not write to %s!\n",fFileName.c_str());
+  fIsOk = false;
+};
+void GFWStateWriter::WriteRecord(int type, const vector<char> &payload) {
+  if(!fFile || type<GFWStateReader::kSetup || type>GFWStateReader::kAccumulator) return;
+  RecordHeader lHeader;
+  memcpy(lHeader.tag,kRecordTags[type],8);
+  lHeader.version = kRecordVersions[type];
+  lHeader.unused = 0;
+  lHeader.size = payload.size();
+  Write(&lHeader,sizeof(lHeader),1);
+  Write(payload.data(),1,payload.size());
+  fNRecords++;
+};
+void GFWStateWriter::WriteSetup(GFW &inGFW) {
+  fPayload.clear();
+  Packer lOut = {fPayload};
+  lOut.Put((int32_t)inGFW.fUseKernels);
+  lOut.Put((int32_t)inGFW.fUseSparseTerms);
+  lOut.Put((int32_t)inGFW.fPoolMinBins);
+  lOut.Put((int32_t)inGFW.fNEtaSlices);
+  lOut.Put(inGFW.fSliceEtaMin);
+  lOut.Put(inGFW.fSliceEtaMax);
+  lOut.Put((uint32_t)inGFW.fAxes.size());
+  for(auto &axis: inGFW.fAxes) { lOut.PutString(axis.Name); lOut.Put((int32_t)axis.NBins); };
+  //Power arrays are only stored if they were set explicitly; otherwise they are derived again from the configurations
+  lOut.Put((uint32_t)inGFW.fRegions.size());
+  for(auto &reg: inGFW.fRegions) {
+    lOut.PutString(reg.rName);
+    lOut.Put(reg.EtaMin);
+    lOut.Put(reg.EtaMax);
+    lOut.Put((int32_t)reg.NpT);
+    lOut.Put((int32_t)reg.BitMask);
+    lOut.Put((int32_t)reg.precision);
+    bool isExplicit = reg.powsDefined && !reg.powsDerived;
+    lOut.Put((int32_t)isExplicit);
+    lOut.PutVector(isExplicit?reg.NparVec:vector<int>{});
+    lOut.PutVector(reg.Axes);
+    lOut.Put((int32_t)reg.Weights);
+  };
+  lOut.Put((uint32_t)inGFW.fListOfCFGs.size());
+  for(auto &cfg: inGFW.fListOfCFGs) {
+    lOut.PutString(cfg.Head);
+    lOut.Put((int32_t)cfg.pTDif);
+    lOut.Put((int32_t)cfg.Engine);
+    lOut.Put((uint32_t)cfg.Regs.size());
+    for(int i=0;i<(int)cfg.Regs.size();i++) {
+      lOut.PutVector(cfg.Regs[i]);
+      lOut.PutVector(cfg.Hars[i]);
+      lOut.Put((int32_t)cfg.Overlap[i]);
+      lOut.Put((int32_t)cfg.ptInd[i]);
+      lOut.PutVector(i<(int)cfg.BinSel.size()?cfg.BinSel[i]:vector<int>{});
+    };
+  };
+  lOut.Put((uint32_t)inGFW.fSegmentPhi.size());
+  lOut.PutArray(inGFW.fSegmentPhi.data(),inGFW.fSegmentPhi.size());
+  WriteRecord(GFWStateReader::kSetup,fPayload);
+};
+void GFWStateWriter::WriteQSnapshot(GFW &inGFW) {
+  fPayload.clear();
+  Packer lOut = {fPayload};
+  const vector<GFWCumulant> &lCumulants = inGFW.GetCumulants();
+  lOut.Put((uint32_t)lCumulants.size());
+  for(auto &cum: lCumulants) {
+    //Bins are stored in order of filling, so that pooled storage gets the same slots when reading
+    vector<pair<int, int> > lTerms = cum.GetTerms();
+    fQBuffer.resize(lTerms.size());
+    lOut.Put((int32_t)cum.GetN());
+    lOut.Put((uint32_t)lTerms.size());
+    for(auto &term: lTerms) { lOut.Put((int32_t)term.first); lOut.Put((int32_t)term.second); };
+    lOut.Put((uint32_t)cum.GetFilledBins().size());
+    for(int bin: cum.GetFilledBins()) {
+      cum.GetBinQ(bin,fQBuffer.data());
+      lOut.Put((int32_t)bin);
+      lOut.PutArray(fQBuffer.data(),fQBuffer.size());
+    };
+  };
+  WriteRecord(GFWStateReader::kQSnapshot,fPayload);
+};
+void GFWStateWriter::WriteAccumulator(const GFWAccumulator &inAcc, string name) {
+  fPayload.clear();
+  Packer lOut = {fPayload};
+  lOut.PutString(name);
+  lOut.Put((int32_t)inAcc.fNOutputs);
+  lOut.Put((int32_t)inAcc.fNSubsamples);
+  lOut.Put((int64_t)inAcc.fNEvents);
+  for(auto &lName: inAcc.fNames) lOut.PutString(lName);
+  lOut.Put((uint32_t)inAcc.fHeadIndex.size());
+  for(auto &head: inAcc.fHeadIndex) { lOut.PutString(head.first); lOut.Put((int32_t)head.second.first); lOut.Put((int32_t)head.second.second); };
+  for(auto &sum: inAcc.fSumValue) { lOut.Put(sum.Sum); lOut.Put(sum.Comp); };
+  for(auto &sum: inAcc.fSumWeight) { lOut.Put(sum.Sum); lOut.Put(sum.Comp); };
+  WriteRecord(GFWStateReader::kAccumulator,fPayload);
+};
+GFWStateReader::GFWStateReader():
+  fFile(0),
+  fFileSize(0),
+  fType(kEnd),
+  fVersion(0),
+  fWarnedMissing(false)
+{
+};
+GFWStateReader::~GFWStateReader() {
+  Close();
+};
+bool GFWStateReader::Open(string fileName) {
+  Close();
+  fFile = fopen(fileName.c_str(),"rb");
+  if(!fFile) { printf("Could not open %s!\n",fileName.c_str()); return false; };
+  fFileName = fileName;
+  fWarnedMissing = false;
+  //Size of the file bounds the size of records, so that a corrupted header cannot request huge amounts of memory
+  if(fseek(fFile,0,SEEK_END) || (fFileSize=ftell(fFile))<0 || fseek(fFile,0,SEEK_SET)) { printf("Could not read %s!\n",fileName.c_str()); Close(); return false; };
+  FileHeader lHeader;
+  if(fread(&lHeader,sizeof(lHeader),1,fFile)!=1 || memcmp(lHeader.magic,kFileMagic,8)) { printf("%s is not a GFW state file!\n",fileName.c_str()); Close(); return false; };
+  if(lHeader.version>kVersion) { printf("%s has a newer version (%u) than supported (%u)!\n",fileName.c_str(),lHeader.version,kVersion); Close(); return false; };
+  return true;
+};
+void GFWStateReader::Close() {
+  if(fFile) fclose(fFile);
+  fFile=0;
+  fType=kEnd;
+  fPayload.clear();
+};
+int GFWStateReader::Next() {
+  fType=kEnd;
+  if(!fFile) return fType;
+  RecordHeader lHeader;
+  while(fread(&lHeader,sizeof(lHeader),1,fFile)==1) {
+    long lPos = ftell(fFile);
+    if(lPos<0 || lHeader.size>(uint64_t)(fFileSize-lPos)) { printf("Corrupted record in %s (larger than the rest of the file)!\n",fFileName.c_str()); break; };
+    int lType=kEnd;
+    for(int i=kSetup;i<=kAccumulator;i++) if(!memcmp(lHeader.tag,kRecordTags[i],8)) lType=i;
+    if(lType==kEnd || lHeader.version>kRecordVersions[lType]) { //Unknown record, or written by a newer version
+      if(fseek(fFile,(long)lHeader.size,SEEK_CUR)) break;
+      continue;
+    };
+    fPayload.resize(lHeader.size);
+    if(fread(fPayload.data(),1,lHeader.size,fFile)!=lHeader.size) { printf("Truncated record in %s!\n",fFileName.c_str()); break; };
+    fType=lType;
+    fVersion=lHeader.version;
+    return fType;
+  };
+  fPayload.clear();
+  return fType;
+};
+bool GFWStateReader::ReadSetup(GFW &inGFW) {
+  if(fType!=kSetup) return false;
+  if(!inGFW.fRegions.empty() || !inGFW.fAxes.empty()) { printf("GFW must be empty to read the setup!\n"); return false; };
+  Unpacker lIn = {fPayload,0,false};
+  inGFW.SetUseKernels(lIn.Get<int32_t>());
+  inGFW.SetUseSparseTerms(lIn.Get<int32_t>());
+  inGFW.SetPooledStorage(lIn.Get<int32_t>());
+  int nSlices = lIn.Get<int32_t>();
+  double lSliceMin = lIn.Get<double>();
+  double lSliceMax = lIn.Get<double>();
+  inGFW.SetEtaSlices(nSlices,lSliceMin,lSliceMax);
+  uint32_t nAxes = lIn.Get<uint32_t>();
+  for(uint32_t i=0;i<nAxes && !lIn.fail;i++) {
+    string lName = lIn.GetString();
+    inGFW.AddAxis(lName,lIn.Get<int32_t>());
+  };
+  uint32_t nRegions = lIn.Get<uint32_t>();
+  for(uint32_t i=0;i<nRegions && !lIn.fail;i++) {
+    GFW::Region lReg;
+    lReg.rName = lIn.GetString();
+    lReg.EtaMin = lIn.Get<double>();
+    lReg.EtaMax = lIn.Get<double>();
+    lReg.NpT = lIn.Get<int32_t>();
+    lReg.BitMask = lIn.Get<int32_t>();
+    lReg.precision = lIn.Get<int32_t>();
+    lReg.powsDefined = lIn.Get<int32_t>();
+    lReg.NparVec = lIn.GetVector();
+    lReg.Nhar = (int)lReg.NparVec.size();
+    lReg.Axes = lIn.GetVector();
+    if(fVersion>=3) lReg.Weights = lIn.Get<int32_t>();
+    if(lReg.Weights>=inGFW.GetNWeights() && !lIn.fail) printf("Region %s uses weight table %i, which is not stored in %s: tables have to be added with AddWeights (in the same order) before CreateRegions!\n",lReg.rName.c_str(),lReg.Weights,fFileName.c_str());
+    inGFW.AddRegion(lReg);
+  };
+  uint32_t nConfigs = lIn.Get<uint32_t>();
+  for(uint32_t i=0;i<nConfigs && !lIn.fail;i++) {
+    GFW::CorrConfig lCfg;
+    lCfg.Head = lIn.GetString();
+    lCfg.pTDif = lIn.Get<int32_t>();
+    lCfg.Engine = lIn.Get<int32_t>();
+    uint32_t nSub = lIn.Get<uint32_t>();
+    bool hasBinSel=false;
+    for(uint32_t j=0;j<nSub && !lIn.fail;j++) {
+      lCfg.Regs.push_back(lIn.GetVector());
+      lCfg.Hars.push_back(lIn.GetVector());
+      lCfg.Overlap.push_back(lIn.Get<int32_t>());
+      lCfg.ptInd.push_back(lIn.Get<int32_t>());
+      lCfg.BinSel.push_back(lIn.GetVector());
+      hasBinSel |= !lCfg.BinSel.back().empty();
+    };
+    if(!hasBinSel) lCfg.BinSel.clear();
+    lCfg.Index = (int)inGFW.fListOfCFGs.size();
+    inGFW.fListOfCFGs.push_back(lCfg);
+  };
+  if(fVersion>=2) {
+    uint32_t nSegments = lIn.Get<uint32_t>();
+    if(lIn.Check((size_t)nSegments*sizeof(double))) {
+      vector<double> lSegmentPhi(nSegments);
+      lIn.GetArray(lSegmentPhi.data(),nSegments);
+      inGFW.SetPhiSegments(lSegmentPhi);
+    };
+  };
+  if(lIn.fail) { printf("Corrupted setup record in %s!\n",fFileName.c_str()); return false; };
+  return true;
+};
+bool GFWStateReader::ReadQSnapshot(GFW &inGFW, long *nMissing) {
+  if(fType!=kQSnapshot) return false;
+  Unpacker lIn = {fPayload,0,false};
+  uint32_t nRegions = lIn.Get<uint32_t>();
+  if(nRegions!=inGFW.fCumulants.size()) { printf("Q-vector snapshot has %u regions, while GFW has %i!\n",nRegions,(int)inGFW.fCumulants.size()); return false; };
+  inGFW.Clear();
+  long lMissing=0;
+  for(uint32_t iReg=0;iReg<nRegions && !lIn.fail;iReg++) {
+    GFWCumulant &cum = inGFW.fCumulants[iReg];
+    int nEntries = lIn.Get<int32_t>();
+    uint32_t nTerms = lIn.Get<uint32_t>();
+    if(!lIn.Check((size_t)nTerms*2*sizeof(int32_t))) break;
+    fTerms.resize(nTerms);
+    bool isValid=true;
+    for(auto &term: fTerms) { term.first = lIn.Get<int32_t>(); term.second = lIn.Get<int32_t>(); isValid &= term.first>=0 && term.second>=0; };
+    if(!isValid) { lIn.fail=true; break; }; //Terms are written with non-negative harmonics and powers
+    fQBuffer.resize(nTerms);
+    uint32_t nBins = lIn.Get<uint32_t>();
+    for(uint32_t i=0;i<nBins && !lIn.fail;i++) {
+      int lBin = lIn.Get<int32_t>();
+      lIn.GetArray(fQBuffer.data(),nTerms);
+      if(!lIn.fail) lMissing += cum.SetBinQ(lBin,fTerms,fQBuffer.data());
+    };
+    cum.AddEntries(nEntries);
+  };
+  if(lIn.fail) { printf("Corrupted Q-vector snapshot in %s!\n",fFileName.c_str()); inGFW.Clear(); return false; };
+  if(lMissing && !fWarnedMissing) {
+    printf("Warning: Q-vector snapshots in %s lack %li terms needed by GFW, these are set to 0! Snapshots to be re-analysed with other configurations should be written with SetUseSparseTerms(false) or with explicitly set powers covering them\n",fFileName.c_str(),lMissing);
+    fWarnedMissing = true;
+  };
+  if(nMissing) *nMissing = lMissing;
+  return true;
+};
+bool GFWStateReader::ReadAccumulator(GFWAccumulator &outAcc, string *name) {
+  if(fType!=kAccumulator) return false;
+  Unpacker lIn = {fPayload,0,false};
+  string lName = lIn.GetString();
+  int nOutputs = lIn.Get<int32_t>();
+  int nSubsamples = lIn.Get<int32_t>();
+  long nEvents = lIn.Get<int64_t>();
+  //Sizes are checked before anything is allocated, so that a corrupted record cannot request huge amounts of memory
+  if(lIn.fail || nOutputs<0 || nSubsamples<0 || (size_t)nOutputs*(nSubsamples+1)*4*sizeof(double)>fPayload.size()) { printf("Corrupted accumulator in %s!\n",fFileName.c_str()); return false; };
+  vector<string> lNames(nOutputs);
+  for(auto &str: lNames) str = lIn.GetString();
+  map<string, pair<int, int> > lHeadIndex;
+  uint32_t nHeads = lIn.Get<uint32_t>();
+  for(uint32_t i=0;i<nHeads && !lIn.fail;i++) {
+    string lHead = lIn.GetString();
+    int lFirst = lIn.Get<int32_t>();
+    lHeadIndex[lHead] = std::make_pair(lFirst,(int)lIn.Get<int32_t>());
+  };
+  vector<GFWAccumulator::KahanSum> lSumValue((nSubsamples+1)*nOutputs), lSumWeight((nSubsamples+1)*nOutputs);
+  for(auto &sum: lSumValue) { sum.Sum = lIn.Get<double>(); sum.Comp = lIn.Get<double>(); };
+  for(auto &sum: lSumWeight) { sum.Sum = lIn.Get<double>(); sum.Comp = lIn.Get<double>(); };
+  if(lIn.fail) { printf("Corrupted accumulator in %s!\n",fFileName.c_str()); return false; };
+  outAcc.fNOutputs = nOutputs;
+  outAcc.fNSubsamples = nSubsamples;
+  outAcc.fNEvents = nEvents;
+  outAcc.fNames.swap(lNames);
+  outAcc.fHeadIndex.swap(lHeadIndex);
+  outAcc.fSumValue.swap(lSumValue);
+  outAcc.fSumWeight.swap(lSumWeight);
+  outAcc.fResults.resize(nOutputs);
+  if(name) *name = lName;
+  return true;
+};
@@ -0,0 +1,81 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Versioned binary format for the state of GFW, to store and combine partial results, e.g. of jobs running on different nodes. The file consists of a header
+and a stream of records, each of them can be written and read on its own, so that neither of them needs to hold more than a single record in memory:
+  Header (16 bytes): "GFWSTATE", uint32 version, uint32 flags (unused)
+  Record: 24-byte record header (char tag[8], uint32 version of the record, uint32 unused, uint64 size of the payload in bytes), followed by the payload
+Record types:
+  SETUP: settings, axes, regions (incl. explicitly set power arrays and indices of their weight tables), correlator configurations, and phi segments of GFW, i.e. everything
+    that is set before CreateRegions, except for the weight tables themselves (these can be large and are usually read from their own files)
+  QSNAP: Q-vectors of all the regions for a single event: for each region the number of entries, its (harmonic, power) terms, and Q-vectors of filled bins only
+  ACCUM: a named GFWAccumulator (layout, number of events, and compensated sums for all the subsamples)
+Strings are stored as uint32 length followed by characters, vectors as uint32 size followed by the elements. Numbers are stored in native byte order.
+Records with unknown tags or newer versions are skipped by the reader, so that new record types can be added without breaking older files or readers.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWSTATEFILE__H
+#define GFWSTATEFILE__H
+#include "GFW.h"
+#include "GFWAccumulator.h"
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <string>
+using std::vector;
+using std::string;
+class GFWStateWriter {
+ public:
+  GFWStateWriter();
+  ~GFWStateWriter();
+  bool Open(string fileName);
+  bool Close(); //Returns false if anything could not be written
+  void WriteSetup(GFW &inGFW); //All the regions and configurations fetched so far
+  void WriteQSnapshot(GFW &inGFW); //Q-vectors of the current event
+  void WriteAccumulator(const GFWAccumulator &inAcc, string name="");
+  void WriteRecord(int type, const vector<char> &payload); //Record with a given payload (e.g. as read by GFWStateReader), type is GFWStateReader::Record_t
+  long GetNRecords() { return fNRecords; };
+ protected:
+  FILE *fFile;
+  string fFileName;
+  bool fIsOk; //All writes so far succeeded
+  long fNRecords;
+  vector<char> fPayload; //! Reused between records
+  vector<complex<double> > fQBuffer; //!
+  void Write(const void *ptr, size_t size, size_t count); //fwrite, reporting the first error
+};
+class GFWStateReader {
+ public:
+  enum Record_t {kEnd=0, kSetup=1, kQSnapshot=2, kAccumulator=3};
+  GFWStateReader();
+  ~GFWStateReader();
+  bool Open(string fileName);
+  void Close();
+  int Next(); //Reads the next record and returns its type, or kEnd at the end of the file (or if the rest of the file is corrupted). Unknown records are skipped
+  //Records are interpreted with the following, each of them returns false if the current record is of a different type or is corrupted
+  //inGFW has to be empty (no regions or axes). Further configurations can be fetched before calling CreateRegions. Weight tables used by the regions
+  //have to be added to inGFW with AddWeights, in the same order as when writing (before or after ReadSetup, but before CreateRegions)
+  bool ReadSetup(GFW &inGFW);
+  //Sets the Q-vectors of initialized GFW to the snapshot, as if the event was filled (inGFW is cleared first). Regions must be the same as when writing,
+  //but configurations can differ: terms that are not in the snapshot are 0, and their number is returned with nMissing (if given).
+  //Snapshots only hold the terms GFW used when writing, which by default (sparse terms) are only those of the configurations fetched before CreateRegions.
+  //To re-analyse snapshots with other configurations, write them with SetUseSparseTerms(false) (all the terms of the dense power arrays) or with explicitly
+  //set powers covering the new harmonics. A warning is printed (once per file) if terms are missing
+  bool ReadQSnapshot(GFW &inGFW, long *nMissing=0);
+  bool ReadAccumulator(GFWAccumulator &outAcc, string *name=0);
+  const vector<char> &GetPayload() { return fPayload; };
+  int GetType() { return fType; };
+  int GetVersion() { return fVersion; }; //Version of the current record. Older versions are still read
+ protected:
+  FILE *fFile;
+  long fFileSize;
+  string fFileName;
+  int fType;
+  int fVersion;
+  bool fWarnedMissing; //Missing terms were already reported for this file
+  vector<char> fPayload; //! Current record
+  vector<pair<int, int> > fTerms; //!
+  vector<complex<double> > fQBuffer; //!
+};
+#endif
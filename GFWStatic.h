@@ -0,0 +1,554 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Compile-time configured version of GFW, for setups where regions and correlators are fixed at build time (e.g. production trains). Regions are types
+with static constexpr members, and correlators are declared as template arguments instead of strings:
+  struct Full { static constexpr double EtaMin=-0.8, EtaMax=0.8; static constexpr int BitMask=1, NpT=1; };
+  struct Poi  { static constexpr double EtaMin=-0.8, EtaMax=0.8; static constexpr int BitMask=2, NpT=10; };
+  struct Ovl  { static constexpr double EtaMin=-0.8, EtaMax=0.8; static constexpr int BitMask=4, NpT=10; };
+  typedef GFWStatic<GFWStaticRegions<Full, Poi, Ovl>,
+                    GFWStaticConfig<false, GFWStaticRef<Full, 2, 2, -2, -2> >,             //"Full {2 2 -2 -2}"
+                    GFWStaticConfig<true,  GFWStaticPoi<Poi, Full, Ovl, 2, 2, -2, -2> > >  //"Poi Full | Ovl {2 2 -2 -2}", pT-differential
+          MyGFW;
+Subevents with a fixed bin (as "(bin)" in the configuration string) are given as GFWStaticSubevent<Poi, Ref, Ovl, bin, harmonics...>, and GFWNoRegion
+stands for a missing overlap. All the rest is done by the compiler: the recursion of GFW (as compiled into GFWPlan by GFW::CompileCorr) is expanded for
+each subevent into a list of nodes (Q-vectors, and products with subtracted terms), from which the (harmonic, power) terms of each region follow.
+Q-vectors of all regions are stored in one std::array, and Fill and CalculateAll run over constexpr tables, so that their loops can be fully unrolled.
+No strings are parsed and nothing is allocated. Semantics are the same as those of GFW (same filling, bins, recursion with its conventions for overlap
+and reference bins, and output of CalculateAll), so the two can be validated against each other: ConfigureGFW sets up a runtime GFW with the same
+regions and configurations (see ValidateStatic.C). Regions with axes and weight tables are not supported.
+Requires C++17. Up to GFWStaticSub::kMaxParticles particles per subevent.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWSTATIC__H
+#define GFWSTATIC__H
+#if __cplusplus < 201703L
+#error "GFWStatic.h requires C++17"
+#endif
+#include "GFW.h"
+#include <array>
+#include <complex>
+#include <utility>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+using std::complex;
+using std::pair;
+using std::string;
+//Declarations of regions and configurations
+struct GFWNoRegion {};
+template<class Poi, class Ref, class Ovl, int PtBin, int... Hars> struct GFWStaticSubevent {};
+template<class Reg, int... Hars> using GFWStaticRef = GFWStaticSubevent<Reg, Reg, GFWNoRegion, -1, Hars...>; //Single region
+template<class Poi, class Ref, class Ovl, int... Hars> using GFWStaticPoi = GFWStaticSubevent<Poi, Ref, Ovl, -1, Hars...>; //POI, ref. and overlap (or GFWNoRegion)
+template<bool PtDif, class... Subevents> struct GFWStaticConfig {};
+template<class... Regions> struct GFWStaticRegions {};
+//Compile-time tables
+struct GFWStaticRegion {
+  double EtaMin=0, EtaMax=0;
+  int BitMask=0, NpT=1;
+};
+struct GFWStaticSub {
+  static constexpr int kMaxParticles = 8;
+  int Config=0, Poi=-1, Ref=-1, Ovl=-1; //Ovl is the overlap used in the calculation: the region itself if POI and ref. are the same and no overlap is given
+  int ExplicitOvl=-1, PtBin=-1, NPart=0;
+  bool PtDif=false;
+  int Hars[kMaxParticles]={};
+};
+//Harmonics and powers of the particles of a correlator in the recursion
+struct GFWStaticKey {
+  int N=0;
+  int Hars[GFWStaticSub::kMaxParticles]={}, Pows[GFWStaticSub::kMaxParticles]={};
+  constexpr unsigned int Hash() const { //Compared first when looking for identical correlators, which makes building much faster
+    unsigned int retHash=N;
+    for(int i=0;i<N;i++) retHash = retHash*131u+(unsigned int)Hars[i]*17u+(unsigned int)Pows[i];
+    return retHash;
+  };
+  constexpr bool operator==(const GFWStaticKey &o) const {
+    if(N!=o.N) return false;
+    for(int i=0;i<N;i++) if(Hars[i]!=o.Hars[i] || Pows[i]!=o.Pows[i]) return false;
+    return true;
+  };
+};
+//Node of a subevent, as in GFWPlan: leaf (Q-vector of a region, taken from the bin of the subevent or from the first one) or value = v[A]*v[B] - sum of
+//Scale*v[Node] over operands [OpStart, OpEnd). A and B are indices within the subevent
+struct GFWStaticNode {
+  bool IsLeaf=false;
+  int Region=-1, Har=0, Pow=0;
+  bool SubBin=false;
+  int A=-1, B=-1, OpStart=0, OpEnd=0;
+  GFWStaticKey Key; //Correlator that the node stands for, to merge identical nodes while building
+  unsigned int Hash=0; //Of the key
+};
+struct GFWStaticOperand {
+  int Node=0;
+  double Scale=0;
+};
+struct GFWStaticTerm {
+  int Har=0, Pow=0;
+};
+//Node with the leaf resolved to a position in the common storage: Index of the first bin, Stride between bins, and NpT of the region
+struct GFWStaticEvalNode {
+  bool IsLeaf=false;
+  int Index=0, Stride=0, NpT=1;
+  bool SubBin=false, Conj=false;
+  int A=-1, B=-1, OpStart=0, OpEnd=0;
+};
+template<class Sub> struct GFWStaticSubTraits;
+template<class P, class R, class O, int B, int... H> struct GFWStaticSubTraits<GFWStaticSubevent<P, R, O, B, H...> > {
+  typedef P Poi;
+  typedef R Ref;
+  typedef O Ovl;
+  static constexpr int kPtBin = B;
+  static constexpr std::array<int, sizeof...(H)> kHars = {{H...}};
+};
+template<class Cfg> struct GFWStaticConfigTraits;
+template<bool PtDif, class... Subs> struct GFWStaticConfigTraits<GFWStaticConfig<PtDif, Subs...> > {
+  static constexpr bool kPtDif = PtDif;
+  static constexpr int kNSub = sizeof...(Subs);
+  template<class Builder, size_t N> static constexpr void Append(std::array<GFWStaticSub, N> &subs, int &ind, int cfg) { ((subs[ind++] = Builder::template MakeSub<Subs>(cfg)), ...); };
+};
+//Builds the tables from the declarations. Only functions, so that they can be used in initializers of GFWStatic
+template<class RegionList, class... Configs> struct GFWStaticBuilder;
+template<class... Regs, class... Configs> struct GFWStaticBuilder<GFWStaticRegions<Regs...>, Configs...> {
+  static constexpr int kNRegions = sizeof...(Regs);
+  static constexpr int kNConfigs = sizeof...(Configs);
+  static constexpr int kNSub = (GFWStaticConfigTraits<Configs>::kNSub + ... + 0);
+  static constexpr int kNGroups = 2*kNSub; //Each subevent is calculated with and without harmonics (group 2*subevent + SetHarmsToZero)
+  static constexpr int kMaxGroupNodes = 1024, kMaxGroupOperands = 4096; //Buffers for building a group, enough for kMaxParticles particles
+  template<class R> static constexpr int RegionIndex() {
+    if(std::is_same<R, GFWNoRegion>::value) return -1;
+    constexpr bool isSame[] = {std::is_same<R, Regs>::value...};
+    for(int i=0;i<kNRegions;i++) if(isSame[i]) return i;
+    return -2;
+  };
+  static constexpr std::array<GFWStaticRegion, kNRegions> GetRegions() { return {{ {Regs::EtaMin, Regs::EtaMax, Regs::BitMask, Regs::NpT}... }}; };
+  template<class Sub> static constexpr GFWStaticSub MakeSub(int cfg) {
+    typedef GFWStaticSubTraits<Sub> T;
+    static_assert(RegionIndex<typename T::Poi>()>-1 && RegionIndex<typename T::Ref>()>-1, "POI and reference of a subevent have to be among the regions");
+    static_assert(RegionIndex<typename T::Ovl>()>-2, "Overlap of a subevent has to be among the regions, or GFWNoRegion");
+    static_assert(T::kHars.size()>0 && (int)T::kHars.size()<=GFWStaticSub::kMaxParticles, "Subevents need 1 to GFWStaticSub::kMaxParticles harmonics");
+    constexpr std::array<GFWStaticRegion, kNRegions> lRegs = GetRegions();
+    GFWStaticSub retSub;
+    retSub.Config = cfg;
+    retSub.Poi = RegionIndex<typename T::Poi>();
+    retSub.Ref = RegionIndex<typename T::Ref>();
+    retSub.ExplicitOvl = RegionIndex<typename T::Ovl>();
+    retSub.Ovl = (retSub.ExplicitOvl<0 && retSub.Poi==retSub.Ref)?retSub.Ref:retSub.ExplicitOvl; //Same as in GFW::Calculate
+    retSub.PtBin = T::kPtBin;
+    retSub.NPart = (int)T::kHars.size();
+    for(int i=0;i<retSub.NPart;i++) retSub.Hars[i] = T::kHars[i];
+    //Same as GFW::IsSubeventPtDif
+    retSub.PtDif = retSub.PtBin<0 && (lRegs[retSub.Poi].NpT>1 || lRegs[retSub.Ref].NpT>1 || (retSub.ExplicitOvl>-1 && lRegs[retSub.ExplicitOvl].NpT>1));
+    return retSub;
+  };
+  static constexpr std::array<GFWStaticSub, kNSub> GetSubevents() {
+    std::array<GFWStaticSub, kNSub> retSubs{};
+    int lInd=0, lCfg=0;
+    (GFWStaticConfigTraits<Configs>::template Append<GFWStaticBuilder>(retSubs,lInd,lCfg++), ...);
+    return retSubs;
+  };
+  static constexpr std::array<int, kNConfigs+1> GetSubOffsets() {
+    std::array<int, kNConfigs+1> retOffsets{};
+    constexpr int lNSub[] = {GFWStaticConfigTraits<Configs>::kNSub..., 0};
+    for(int i=0;i<kNConfigs;i++) retOffsets[i+1] = retOffsets[i]+lNSub[i];
+    return retOffsets;
+  };
+  //Layout of the output of CalculateAll, as in GFW::GetConfigNpT
+  static constexpr std::array<int, kNConfigs+1> GetOutputOffsets() {
+    constexpr std::array<GFWStaticRegion, kNRegions> lRegs = GetRegions();
+    constexpr std::array<GFWStaticSub, kNSub> lSubs = GetSubevents();
+    constexpr bool lPtDif[] = {GFWStaticConfigTraits<Configs>::kPtDif..., false};
+    std::array<int, kNConfigs+1> retOffsets{};
+    for(int iCfg=0;iCfg<kNConfigs;iCfg++) {
+      int lNpT=1;
+      for(int i=0;i<kNSub && lPtDif[iCfg];i++) {
+        if(lSubs[i].Config!=iCfg) continue;
+        lNpT = std::max(lNpT,std::max(lRegs[lSubs[i].Poi].NpT,lRegs[lSubs[i].Ref].NpT));
+        if(lSubs[i].ExplicitOvl>-1) lNpT = std::max(lNpT,lRegs[lSubs[i].ExplicitOvl].NpT);
+      };
+      retOffsets[iCfg+1] = retOffsets[iCfg]+lNpT;
+    };
+    return retOffsets;
+  };
+  //Nodes of one group, written to the given tables. Children are always added before their parents, so the nodes can be evaluated in order, and the last
+  //one is the result
+  struct GroupNodes {
+    GFWStaticNode *Nodes;
+    GFWStaticOperand *Operands;
+    int NNodes, NOperands;
+  };
+  //Same as GFW::CompileLeaf. The bin does not matter for regions with a single bin, so those leaves are always taken from the first one
+  static constexpr int AddLeaf(GroupNodes &grp, int reg, int har, int pow, bool subBin) {
+    constexpr std::array<GFWStaticRegion, kNRegions> lRegs = GetRegions();
+    subBin = subBin && lRegs[reg].NpT>1;
+    for(int i=0;i<grp.NNodes;i++) {
+      const GFWStaticNode &lNode = grp.Nodes[i];
+      if(lNode.IsLeaf && lNode.Region==reg && lNode.Har==har && lNode.Pow==pow && lNode.SubBin==subBin) return i;
+    };
+    GFWStaticNode lNode;
+    lNode.IsLeaf = true;
+    lNode.Region = reg;
+    lNode.Har = har;
+    lNode.Pow = pow;
+    lNode.SubBin = subBin;
+    grp.Nodes[grp.NNodes] = lNode;
+    return grp.NNodes++;
+  };
+  static constexpr int AddMulSub(GroupNodes &grp, const GFWStaticKey &key, int a, int b, const GFWStaticOperand *subtract, int nSubtract) {
+    GFWStaticNode lNode;
+    lNode.Key = key;
+    lNode.Hash = key.Hash();
+    lNode.A = a;
+    lNode.B = b;
+    lNode.OpStart = grp.NOperands;
+    for(int i=0;i<nSubtract;i++) grp.Operands[grp.NOperands++] = subtract[i];
+    lNode.OpEnd = grp.NOperands;
+    grp.Nodes[grp.NNodes] = lNode;
+    return grp.NNodes++;
+  };
+  //Same as GFW::CompileCorr (and thus GFW::RecursiveCorr), with identical correlators of the subevent merged
+  static constexpr int CompileCorr(GroupNodes &grp, const GFWStaticSub &sub, GFWStaticKey key) {
+    int poi = (key.Pows[0]!=1 && sub.Ovl>-1)?sub.Ovl:sub.Poi; //if the power of POI is not unity, then always use overlap (if defined)
+    if(key.N<2) return AddLeaf(grp,poi,key.Hars[0],key.Pows[0],true);
+    unsigned int lHash = key.Hash();
+    for(int i=0;i<grp.NNodes;i++) if(!grp.Nodes[i].IsLeaf && grp.Nodes[i].Hash==lHash && grp.Nodes[i].Key==key) return i;
+    GFWStaticOperand lSub[GFWStaticSub::kMaxParticles]={};
+    int nSub=0;
+    if(key.N<3) { //Same as TwoRec
+      if(sub.Ovl>-1) lSub[nSub++] = {AddLeaf(grp,sub.Ovl,key.Hars[0]+key.Hars[1],key.Pows[0]+key.Pows[1],true), 1};
+      int a = AddLeaf(grp,poi,key.Hars[0],key.Pows[0],true);
+      int b = AddLeaf(grp,sub.Ref,key.Hars[1],key.Pows[1],true);
+      return AddMulSub(grp,key,a,b,lSub,nSub);
+    };
+    GFWStaticKey lPrevKey = key;
+    lPrevKey.N--;
+    int harlast = key.Hars[key.N-1], powlast = key.Pows[key.N-1];
+    int lPrev = CompileCorr(grp,sub,lPrevKey);
+    int lLast = AddLeaf(grp,sub.Ref,harlast,powlast,false); //Reference is always taken from the first pT bin, as in RecursiveCorr
+    int lDegeneracy=1;
+    for(int i=lPrevKey.N-1;i>=0;i--) {
+      if(i>2 && lPrevKey.Hars[i]==lPrevKey.Hars[i-1] && lPrevKey.Pows[i]==lPrevKey.Pows[i-1]) { lDegeneracy++; continue; };
+      GFWStaticKey lSubKey = lPrevKey;
+      lSubKey.Hars[i]+=harlast;
+      lSubKey.Pows[i]+=powlast;
+      int lNode = CompileCorr(grp,sub,lSubKey);
+      lSub[nSub++] = {lNode, (double)lDegeneracy};
+      lDegeneracy=1;
+    };
+    return AddMulSub(grp,key,lPrev,lLast,lSub,nSub);
+  };
+  static constexpr void CompileGroup(int group, GroupNodes &grp) {
+    constexpr std::array<GFWStaticSub, kNSub> lSubs = GetSubevents();
+    const GFWStaticSub &sub = lSubs[group/2];
+    GFWStaticKey lKey;
+    lKey.N = sub.NPart;
+    for(int i=0;i<sub.NPart;i++) { lKey.Hars[i] = (group%2)?0:sub.Hars[i]; lKey.Pows[i] = 1; };
+    CompileCorr(grp,sub,lKey);
+  };
+  //First node (first) and operand (second) of each group in the tables of all groups, and the ends of the last one. Groups are compiled one by one
+  //into the same buffers, so that these can be large enough for any subevent
+  static constexpr pair<std::array<int, kNGroups+1>, std::array<int, kNGroups+1> > GetGroupOffsets() {
+    GFWStaticNode lNodes[kMaxGroupNodes]={};
+    GFWStaticOperand lOperands[kMaxGroupOperands]={};
+    pair<std::array<int, kNGroups+1>, std::array<int, kNGroups+1> > retOffsets{};
+    for(int g=0;g<kNGroups;g++) {
+      GroupNodes lGroup = {lNodes, lOperands, 0, 0};
+      CompileGroup(g,lGroup);
+      retOffsets.first[g+1] = retOffsets.first[g]+lGroup.NNodes;
+      retOffsets.second[g+1] = retOffsets.second[g]+lGroup.NOperands;
+    };
+    return retOffsets;
+  };
+  //Nodes of all groups. Operands are indexed in the table of all groups, while A, B and nodes of operands stay within the group
+  template<int N, int NOp> static constexpr pair<std::array<GFWStaticNode, N>, std::array<GFWStaticOperand, NOp> > GetNodes() {
+    pair<std::array<GFWStaticNode, N>, std::array<GFWStaticOperand, NOp> > retNodes{};
+    int lNode=0, lOperand=0;
+    for(int g=0;g<kNGroups;g++) {
+      GroupNodes lGroup = {retNodes.first.data()+lNode, retNodes.second.data()+lOperand, 0, 0};
+      CompileGroup(g,lGroup);
+      for(int i=0;i<lGroup.NNodes;i++) {
+        lGroup.Nodes[i].OpStart+=lOperand;
+        lGroup.Nodes[i].OpEnd+=lOperand;
+      };
+      lNode+=lGroup.NNodes;
+      lOperand+=lGroup.NOperands;
+    };
+    return retNodes;
+  };
+  //(|harmonic|, power) terms of each region, sorted and without duplicates. With out!=0, terms of region reg are written there
+  template<size_t N> static constexpr int GetTerms(const std::array<GFWStaticNode, N> &nodes, int reg, GFWStaticTerm *out) {
+    GFWStaticTerm lTerms[N+1]={};
+    int nTerms=0;
+    for(size_t i=0;i<N;i++) {
+      const GFWStaticNode &lNode = nodes[i];
+      if(!lNode.IsLeaf || lNode.Region!=reg) continue;
+      GFWStaticTerm lTerm = {lNode.Har<0?-lNode.Har:lNode.Har, lNode.Pow};
+      int k=nTerms;
+      for(;k>0 && (lTerms[k-1].Har>lTerm.Har || (lTerms[k-1].Har==lTerm.Har && lTerms[k-1].Pow>lTerm.Pow));k--) ;
+      if(k>0 && lTerms[k-1].Har==lTerm.Har && lTerms[k-1].Pow==lTerm.Pow) continue;
+      for(int l=nTerms;l>k;l--) lTerms[l] = lTerms[l-1];
+      lTerms[k] = lTerm;
+      nTerms++;
+    };
+    for(int i=0;i<nTerms && out;i++) out[i] = lTerms[i];
+    return nTerms;
+  };
+};
+template<class RegionList, class... Configs> class GFWStatic;
+template<class... Regs, class... Configs> class GFWStatic<GFWStaticRegions<Regs...>, Configs...> {
+  typedef GFWStaticBuilder<GFWStaticRegions<Regs...>, Configs...> Builder;
+ public:
+  static constexpr int kNRegions = Builder::kNRegions;
+  static constexpr int kNConfigs = Builder::kNConfigs;
+  static constexpr int kNSub = Builder::kNSub;
+  static constexpr std::array<GFWStaticRegion, kNRegions> kRegions = Builder::GetRegions();
+  static constexpr std::array<GFWStaticSub, kNSub> kSubs = Builder::GetSubevents();
+  static constexpr std::array<int, kNConfigs+1> kSubOffsets = Builder::GetSubOffsets(); //Subevents of configuration i are [kSubOffsets[i], kSubOffsets[i+1])
+  static constexpr std::array<int, kNConfigs+1> kOutputOffsets = Builder::GetOutputOffsets();
+  static constexpr int kNOutputs = kOutputOffsets[kNConfigs];
+  static constexpr std::array<int, Builder::kNGroups+1> kNodeOffsets = Builder::GetGroupOffsets().first; //Nodes of group g are [kNodeOffsets[g], kNodeOffsets[g+1])
+  static constexpr std::array<int, Builder::kNGroups+1> kOperandOffsets = Builder::GetGroupOffsets().second;
+  static constexpr int kNNodes = kNodeOffsets[Builder::kNGroups];
+  static constexpr int kNOperands = kOperandOffsets[Builder::kNGroups];
+  GFWStatic() { Clear(); };
+  void Clear() {
+    fQ.fill(complex<double>(0,0));
+    fFilled.fill(false);
+    fN.fill(0);
+  };
+  void Fill(double eta, int ptin, double phi, double weight, int mask, double secondWeight=-1) {
+    //e^{i n phi} for all harmonics with the same recurrence as GFWCumulant, and w*m^(p-1) for all powers
+    std::array<complex<double>, kMaxHar+1> lPhase;
+    const double lCos1 = cos(phi), lSin1 = sin(phi);
+    double lCos = 1, lSin = 0;
+    for(int n=0;n<=kMaxHar;n++) {
+      lPhase[n] = complex<double>(lCos,lSin);
+      double lTmp = lCos*lCos1 - lSin*lSin1;
+      lSin = lSin*lCos1 + lCos*lSin1;
+      lCos = lTmp;
+    };
+    std::array<double, kMaxPow+1> lPrefactor;
+    const double lMult = (secondWeight>0)?secondWeight:weight;
+    lPrefactor[0] = 1;
+    for(int p=1;p<=kMaxPow;p++) lPrefactor[p] = lPrefactor[p-1]*((p>1)?lMult:weight);
+    FillRegions(eta,ptin,mask,lPhase,lPrefactor,std::make_index_sequence<kNRegions>());
+  };
+  void Fill(int nTracks, const double *eta, const int *ptin, const double *phi, const double *weight, const int *mask, const double *secondWeight=0) {
+    for(int i=0;i<nTracks;i++) Fill(eta[i],ptin[i],phi[i],weight[i],mask[i],secondWeight?secondWeight[i]:-1);
+  };
+  //Same as GFW::Calculate for configuration iCfg (in order of the template arguments)
+  complex<double> Calculate(int iCfg, int ptbin, bool SetHarmsToZero) const {
+    complex<double> retVal(1,0);
+    for(int i=kSubOffsets[iCfg];i<kSubOffsets[iCfg+1];i++) {
+      if(!IsSubeventFilled(i,ptbin)) return complex<double>(0,0);
+      retVal = Mult(retVal,Evaluate(2*i+SetHarmsToZero,GetSubeventBin(i,ptbin)));
+    };
+    return retVal;
+  };
+  //Same as GFW::CalculateAll, with the same layout of the output (see GetOutputIndex)
+  void CalculateAll(pair<double, double> *out) const { CalculateConfigs(out,std::make_index_sequence<kNConfigs>()); };
+  static constexpr int GetNOutputs() { return kNOutputs; };
+  static constexpr int GetOutputIndex(int iCfg, int ptbin=0) { return kOutputOffsets[iCfg]+ptbin; };
+  static constexpr int GetNTerms() { return kNTerms; }; //Number of (harmonic, power) terms of all regions
+  static constexpr int GetQSize() { return kQSize; }; //Number of stored Q-vectors, including bins
+  int GetN(int reg) const { return fN[reg]; };
+  //Sets up a runtime GFW with the same regions (named reg0, reg1, ...) and configurations (cfg0, cfg1, ...), after which CreateRegions has to be called
+  static void ConfigureGFW(GFW &gfw) {
+    for(int i=0;i<kNRegions;i++) gfw.AddRegion("reg"+std::to_string(i),kRegions[i].EtaMin,kRegions[i].EtaMax,kRegions[i].NpT,kRegions[i].BitMask);
+    constexpr bool lPtDif[] = {GFWStaticConfigTraits<Configs>::kPtDif..., false};
+    for(int iCfg=0;iCfg<kNConfigs;iCfg++) {
+      string lConfig="";
+      for(int i=kSubOffsets[iCfg];i<kSubOffsets[iCfg+1];i++) {
+        const GFWStaticSub &sub = kSubs[i];
+        lConfig+=(lConfig.empty()?"":" ")+string("reg")+std::to_string(sub.Poi);
+        if(sub.Ref!=sub.Poi || sub.ExplicitOvl>-1) lConfig+=" reg"+std::to_string(sub.Ref);
+        if(sub.ExplicitOvl>-1) lConfig+=" | reg"+std::to_string(sub.ExplicitOvl);
+        if(sub.PtBin>-1) lConfig+=" ("+std::to_string(sub.PtBin)+")";
+        lConfig+=" {";
+        for(int j=0;j<sub.NPart;j++) lConfig+=(j?" ":"")+std::to_string(sub.Hars[j]);
+        lConfig+="}";
+      };
+      gfw.GetCorrelatorConfig(lConfig,"cfg"+std::to_string(iCfg),lPtDif[iCfg]);
+    };
+  };
+ protected:
+  static constexpr pair<std::array<GFWStaticNode, kNNodes>, std::array<GFWStaticOperand, kNOperands+1> > kNodes = Builder::template GetNodes<kNNodes, kNOperands+1>();
+  //Terms and storage: region r has terms [kTermOffsets[r], kTermOffsets[r+1]), stored for each of its bins from kQOffsets[r] on
+  static constexpr std::array<int, kNRegions+1> GetTermOffsets() {
+    std::array<int, kNRegions+1> retOffsets{};
+    for(int r=0;r<kNRegions;r++) retOffsets[r+1] = retOffsets[r]+Builder::GetTerms(kNodes.first,r,(GFWStaticTerm*)0);
+    return retOffsets;
+  };
+  static constexpr std::array<int, kNRegions+1> kTermOffsets = GetTermOffsets();
+  static constexpr int kNTerms = kTermOffsets[kNRegions];
+  static constexpr std::array<GFWStaticTerm, kNTerms+1> GetAllTerms() {
+    std::array<GFWStaticTerm, kNTerms+1> retTerms{};
+    for(int r=0;r<kNRegions;r++) Builder::GetTerms(kNodes.first,r,retTerms.data()+kTermOffsets[r]);
+    return retTerms;
+  };
+  static constexpr std::array<GFWStaticTerm, kNTerms+1> kTerms = GetAllTerms();
+  static constexpr std::array<int, kNRegions+1> GetQOffsets() {
+    std::array<int, kNRegions+1> retOffsets{};
+    for(int r=0;r<kNRegions;r++) retOffsets[r+1] = retOffsets[r]+kRegions[r].NpT*(kTermOffsets[r+1]-kTermOffsets[r]);
+    return retOffsets;
+  };
+  static constexpr std::array<int, kNRegions+1> kQOffsets = GetQOffsets();
+  static constexpr int kQSize = kQOffsets[kNRegions];
+  static constexpr std::array<int, kNRegions+1> GetBinOffsets() {
+    std::array<int, kNRegions+1> retOffsets{};
+    for(int r=0;r<kNRegions;r++) retOffsets[r+1] = retOffsets[r]+kRegions[r].NpT;
+    return retOffsets;
+  };
+  static constexpr std::array<int, kNRegions+1> kBinOffsets = GetBinOffsets();
+  static constexpr int GetMax(bool pow) {
+    int retMax=0;
+    for(int i=0;i<kNTerms;i++) retMax = std::max(retMax,pow?kTerms[i].Pow:kTerms[i].Har);
+    return retMax;
+  };
+  static constexpr int kMaxHar = GetMax(false);
+  static constexpr int kMaxPow = GetMax(true);
+  static constexpr int GetMaxGroupNodes() {
+    int retMax=1;
+    for(int g=0;g<Builder::kNGroups;g++) retMax = std::max(retMax,kNodeOffsets[g+1]-kNodeOffsets[g]);
+    return retMax;
+  };
+  static constexpr int kMaxGroupNodes = GetMaxGroupNodes();
+  //Nodes with leaves resolved to positions in the storage
+  static constexpr std::array<GFWStaticEvalNode, kNNodes+1> GetEvalNodes() {
+    std::array<GFWStaticEvalNode, kNNodes+1> retNodes{};
+    for(int i=0;i<kNNodes;i++) {
+      const GFWStaticNode &lNode = kNodes.first[i];
+      GFWStaticEvalNode &lEval = retNodes[i];
+      lEval.IsLeaf = lNode.IsLeaf;
+      lEval.A = lNode.A;
+      lEval.B = lNode.B;
+      lEval.OpStart = lNode.OpStart;
+      lEval.OpEnd = lNode.OpEnd;
+      if(!lNode.IsLeaf) continue;
+      int r = lNode.Region, lHar = lNode.Har<0?-lNode.Har:lNode.Har;
+      int lTerm = kTermOffsets[r];
+      while(kTerms[lTerm].Har!=lHar || kTerms[lTerm].Pow!=lNode.Pow) lTerm++;
+      lEval.Stride = kTermOffsets[r+1]-kTermOffsets[r];
+      lEval.Index = kQOffsets[r]+lTerm-kTermOffsets[r];
+      lEval.NpT = kRegions[r].NpT;
+      lEval.SubBin = lNode.SubBin;
+      lEval.Conj = lNode.Har<0;
+    };
+    return retNodes;
+  };
+  static constexpr std::array<GFWStaticEvalNode, kNNodes+1> kEvalNodes = GetEvalNodes();
+  std::array<complex<double>, kQSize+1> fQ;
+  std::array<bool, kBinOffsets[kNRegions]> fFilled; //Per region and bin
+  std::array<int, kNRegions> fN; //Number of tracks per region
+  template<int r> void FillRegion(double eta, int ptin, int mask, const std::array<complex<double>, kMaxHar+1> &phase, const std::array<double, kMaxPow+1> &prefactor) {
+    constexpr GFWStaticRegion lReg = kRegions[r];
+    if(!(lReg.EtaMin<eta && eta<lReg.EtaMax) || !(lReg.BitMask&mask)) return;
+    //Same as GFWCumulant::FillArray: with a single bin, everything goes into it; otherwise out-of-range tracks are dropped
+    int lBin = (lReg.NpT==1)?0:ptin;
+    if(lBin<0 || lBin>=lReg.NpT) return;
+    constexpr int lFirst = kTermOffsets[r], lN = kTermOffsets[r+1]-kTermOffsets[r];
+    complex<double> *lQ = fQ.data()+kQOffsets[r]+lBin*lN;
+    for(int t=0;t<lN;t++) lQ[t] += prefactor[kTerms[lFirst+t].Pow]*phase[kTerms[lFirst+t].Har];
+    fFilled[kBinOffsets[r]+lBin] = true;
+    fN[r]++;
+  };
+  template<size_t... R> void FillRegions(double eta, int ptin, int mask, const std::array<complex<double>, kMaxHar+1> &phase, const std::array<double, kMaxPow+1> &prefactor, std::index_sequence<R...>) {
+    (FillRegion<R>(eta,ptin,mask,phase,prefactor), ...);
+  };
+  static complex<double> Mult(const complex<double> &a, const complex<double> &b) { return complex<double>(a.real()*b.real()-a.imag()*b.imag(),a.real()*b.imag()+a.imag()*b.real()); }; //Without the checks for inf/nan of operator*
+  complex<double> GetQ(const GFWStaticEvalNode &node, int ptbin) const {
+    int lBin = (!node.SubBin || ptbin<0 || ptbin>=node.NpT)?0:ptbin; //Out-of-range bins fall back to the first one, as in GFWCumulant::Vec
+    const complex<double> &lQ = fQ[node.Index+lBin*node.Stride];
+    return node.Conj?conj(lQ):lQ;
+  };
+  //Nodes of a group, for configurations chosen at runtime (Calculate)
+  complex<double> Evaluate(int group, int ptbin) const {
+    complex<double> lValues[kMaxGroupNodes];
+    const GFWStaticEvalNode *lNodes = kEvalNodes.data()+kNodeOffsets[group];
+    int nNodes = kNodeOffsets[group+1]-kNodeOffsets[group];
+    for(int i=0;i<nNodes;i++) {
+      const GFWStaticEvalNode &lNode = lNodes[i];
+      if(lNode.IsLeaf) { lValues[i] = GetQ(lNode,ptbin); continue; };
+      lValues[i] = Mult(lValues[lNode.A],lValues[lNode.B]);
+      for(int j=lNode.OpStart;j<lNode.OpEnd;j++) lValues[i] -= kNodes.second[j].Scale*lValues[kNodes.second[j].Node];
+    };
+    return lValues[nNodes-1];
+  };
+  //Same with everything known at compile time, so that the nodes of a group are unrolled (CalculateAll)
+  template<int k> void EvaluateNode(complex<double> *values, int ptbin) const {
+    constexpr GFWStaticEvalNode lNode = kEvalNodes[k];
+    constexpr int i = k-kNodeOffsets[GetGroup(k)];
+    if constexpr(lNode.IsLeaf) {
+      int lBin = 0;
+      if constexpr(lNode.SubBin) lBin = (ptbin<0 || ptbin>=lNode.NpT)?0:ptbin;
+      const complex<double> &lQ = fQ[lNode.Index+lBin*lNode.Stride];
+      if constexpr(lNode.Conj) values[i] = conj(lQ);
+      else values[i] = lQ;
+    } else {
+      values[i] = Mult(values[lNode.A],values[lNode.B]);
+      SubtractOperands<lNode.OpStart>(values[i],values,std::make_index_sequence<lNode.OpEnd-lNode.OpStart>());
+    };
+  };
+  template<int first, size_t... J> void SubtractOperands(complex<double> &val, const complex<double> *values, std::index_sequence<J...>) const {
+    ((val -= kNodes.second[first+J].Scale*values[kNodes.second[first+J].Node]), ...);
+  };
+  template<int first, size_t... K> void EvaluateNodes(complex<double> *values, int ptbin, std::index_sequence<K...>) const { (EvaluateNode<first+(int)K>(values,ptbin), ...); };
+  template<int group> complex<double> Evaluate(int ptbin) const {
+    constexpr int lFirst = kNodeOffsets[group], nNodes = kNodeOffsets[group+1]-kNodeOffsets[group];
+    complex<double> lValues[nNodes];
+    EvaluateNodes<lFirst>(lValues,ptbin,std::make_index_sequence<nNodes>());
+    return lValues[nNodes-1];
+  };
+  static constexpr int GetGroup(int node) {
+    int retGroup=0;
+    while(kNodeOffsets[retGroup+1]<=node) retGroup++;
+    return retGroup;
+  };
+  static constexpr int GetSubeventBin(int sub, int ptbin) { return (kSubs[sub].PtBin>-1)?kSubs[sub].PtBin:ptbin; };
+  bool IsBinFilled(int reg, int bin) const { //Same as GFWCumulant::IsPtBinFilled
+    if(kRegions[reg].NpT==1) bin=0;
+    else if(bin<0 || bin>=kRegions[reg].NpT) return false;
+    return fFilled[kBinOffsets[reg]+bin];
+  };
+  bool IsSubeventFilled(int sub, int ptbin) const { //Same as GFW::IsSubeventFilled
+    const GFWStaticSub &lSub = kSubs[sub];
+    int ptInd = GetSubeventBin(sub,ptbin);
+    if(!IsBinFilled(lSub.Ref,ptInd) || !IsBinFilled(lSub.Poi,ptInd)) return false;
+    return fN[lSub.Ref] >= lSub.NPart-(lSub.Poi!=lSub.Ref);
+  };
+  //Multiplies the value and the normalization of subevents with the given dependence on the bin. Stops at the first one that is not filled
+  template<bool ptDif, size_t... S> bool MultiplySubevents(int ptbin, complex<double> &val, complex<double> &norm, std::index_sequence<S...>) const {
+    bool retFilled = true;
+    auto lMultiply = [&](auto sub) {
+      constexpr int i = decltype(sub)::value;
+      if constexpr(kSubs[i].PtDif==ptDif) {
+        if(!retFilled) return;
+        retFilled = IsSubeventFilled(i,ptbin);
+        val = Mult(val,Evaluate<2*i>(GetSubeventBin(i,ptbin)));
+        norm = Mult(norm,Evaluate<2*i+1>(GetSubeventBin(i,ptbin)));
+      };
+    };
+    (lMultiply(std::integral_constant<int, (int)S>()), ...);
+    return retFilled;
+  };
+  template<int first, size_t... I> static std::index_sequence<first+I...> OffsetSequence(std::index_sequence<I...>);
+  //Same as GFW::CalculateAll: subevents that do not depend on the bin are calculated once
+  template<int iCfg> void CalculateConfig(pair<double, double> *out) const {
+    constexpr int lNpT = kOutputOffsets[iCfg+1]-kOutputOffsets[iCfg];
+    typedef decltype(OffsetSequence<kSubOffsets[iCfg]>(std::make_index_sequence<kSubOffsets[iCfg+1]-kSubOffsets[iCfg]>())) Subevents;
+    pair<double, double> *lOut = out+kOutputOffsets[iCfg];
+    complex<double> lVal(1,0), lNorm(1,0);
+    bool isFilled = MultiplySubevents<false>(0,lVal,lNorm,Subevents());
+    for(int ptbin=0;ptbin<lNpT;ptbin++) {
+      lOut[ptbin] = std::make_pair(0.,0.);
+      if(!isFilled) continue;
+      complex<double> lPtVal = lVal, lPtNorm = lNorm;
+      if(!MultiplySubevents<true>(ptbin,lPtVal,lPtNorm,Subevents()) || lPtNorm.real()==0) continue;
+      lOut[ptbin] = std::make_pair(lPtVal.real()/lPtNorm.real(),lPtNorm.real());
+    };
+  };
+  template<size_t... C> void CalculateConfigs(pair<double, double> *out, std::index_sequence<C...>) const { (CalculateConfig<C>(out), ...); };
+};
+#endif
@@ -0,0 +1,83 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Persistent thread pool, see the header for details.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#include "GFWThreadPool.h"
+GFWThreadPool::GFWThreadPool(int nThreads):
+  fNThreads(1),
+  fTask(0),
+  fNTasks(0),
+  fNextTask(0),
+  fNBusy(0),
+  fGeneration(0),
+  fStop(false)
+{
+  SetNThreads(nThreads);
+};
+GFWThreadPool::GFWThreadPool(const GFWThreadPool &other):
+  GFWThreadPool(other.fNThreads)
+{
+};
+GFWThreadPool &GFWThreadPool::operator=(const GFWThreadPool &other) {
+  if(this!=&other) SetNThreads(other.fNThreads);
+  return *this;
+};
+GFWThreadPool::~GFWThreadPool() {
+  Stop();
+};
+void GFWThreadPool::SetNThreads(int nThreads) {
+  Stop();
+  if(nThreads<=0) nThreads = (int)std::thread::hardware_concurrency();
+  fNThreads = (nThreads>0)?nThreads:1;
+};
+void GFWThreadPool::Start() {
+  fStop=false;
+  for(int i=1;i<fNThreads;i++) fThreads.push_back(std::thread(&GFWThreadPool::Worker,this,fGeneration));
+};
+void GFWThreadPool::Stop() {
+  if(fThreads.empty()) return;
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStop=true;
+  }
+  fStartCV.notify_all();
+  for(auto &thr: fThreads) thr.join();
+  fThreads.clear();
+};
+void GFWThreadPool::RunTasks() {
+  for(int iTask=fNextTask++;iTask<fNTasks;iTask=fNextTask++) (*fTask)(iTask);
+};
+void GFWThreadPool::Worker(long lGeneration) {
+  while(true) {
+    {
+      std::unique_lock<std::mutex> lock(fMutex);
+      fStartCV.wait(lock,[&]() { return fStop || fGeneration!=lGeneration; });
+      if(fStop) return;
+      lGeneration = fGeneration;
+    }
+    RunTasks();
+    std::lock_guard<std::mutex> lock(fMutex);
+    if(!--fNBusy) fDoneCV.notify_one();
+  };
+};
+void GFWThreadPool::Run(int nTasks, const std::function<void(int)> &task) {
+  if(nTasks<1) return;
+  if(fNThreads<2 || nTasks<2) { for(int i=0;i<nTasks;i++) task(i); return; };
+  if(fThreads.empty()) Start();
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fTask = &task;
+    fNTasks = nTasks;
+    fNextTask = 0;
+    fNBusy = (int)fThreads.size();
+    fGeneration++;
+  }
+  fStartCV.notify_all();
+  RunTasks();
+  //All the threads have to be done with this run before returning, since the next run reuses fTask and fNextTask
+  std::unique_lock<std::mutex> lock(fMutex);
+  fDoneCV.wait(lock,[&]() { return fNBusy==0; });
+};
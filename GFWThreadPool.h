@@ -0,0 +1,45 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Minimal persistent thread pool for work within a single event (see GFW::SetFillThreads). Threads are started on the first Run and then wait for
+further calls, so that the cost of a Run is a wake-up rather than thread creation. The calling thread takes part in the work.
+Copies do not share threads: a copy starts its own when it is first run (e.g. GFW clones in GFWDriver).
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWTHREADPOOL__H
+#define GFWTHREADPOOL__H
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+using std::vector;
+class GFWThreadPool {
+ public:
+  GFWThreadPool(int nThreads=1);
+  GFWThreadPool(const GFWThreadPool &other);
+  GFWThreadPool &operator=(const GFWThreadPool &other);
+  ~GFWThreadPool();
+  void SetNThreads(int nThreads); //Including the calling thread; <=0 uses all available cores. Running threads are stopped
+  int GetNThreads() const { return fNThreads; };
+  //Calls task(i) for i = 0..nTasks-1, each exactly once, and returns when all of them are done. Tasks are taken in order, but can run on any thread
+  void Run(int nTasks, const std::function<void(int)> &task);
+ protected:
+  int fNThreads;
+  vector<std::thread> fThreads;
+  std::mutex fMutex;
+  std::condition_variable fStartCV, fDoneCV;
+  const std::function<void(int)> *fTask;
+  int fNTasks;
+  std::atomic<int> fNextTask;
+  int fNBusy; //Threads that have not finished the current run yet
+  long fGeneration; //Incremented with each run, so that threads can tell a new run from a spurious wake-up
+  bool fStop;
+  void Start();
+  void Stop();
+  void Worker(long lGeneration); //lGeneration is the last run the thread has seen
+  void RunTasks();
+};
+#endif
@@ -0,0 +1,178 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Table of track weights, see the header for details.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#include "GFWWeightTable.h"
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+namespace {
+  const char kWeightsMagic[8] = {'G','F','W','W','G','H','T','S'};
+  const uint32_t kWeightsVersion = 1;
+}
+GFWWeightTable::GFWWeightTable():
+  fBlock(0),
+  fValues(0),
+  fNValues(0),
+  fEventOffset(0)
+{
+  Allocate(1); //Without axes, the table is a single value of 1
+};
+GFWWeightTable::~GFWWeightTable() {
+  ::operator delete(fBlock);
+};
+GFWWeightTable::GFWWeightTable(const GFWWeightTable &other):
+  fAxes(other.fAxes),
+  fBlock(0),
+  fValues(0),
+  fNValues(0),
+  fEventOffset(other.fEventOffset)
+{
+  Allocate(0);
+  memcpy(fValues,other.fValues,fNValues*sizeof(double));
+};
+GFWWeightTable &GFWWeightTable::operator=(GFWWeightTable other) {
+  swap(other);
+  return *this;
+};
+void GFWWeightTable::swap(GFWWeightTable &other) noexcept {
+  fAxes.swap(other.fAxes);
+  std::swap(fBlock,other.fBlock);
+  std::swap(fValues,other.fValues);
+  std::swap(fNValues,other.fNValues);
+  std::swap(fEventOffset,other.fEventOffset);
+};
+void GFWWeightTable::Allocate(double value) {
+  ::operator delete(fBlock);
+  fNValues=1;
+  for(auto &axis: fAxes) { axis.Stride = fNValues; fNValues*=axis.NBins; };
+  fBlock = ::operator new(fNValues*sizeof(double)+kAlignment);
+  fValues = reinterpret_cast<double*>((reinterpret_cast<size_t>(fBlock)+kAlignment-1)&~(kAlignment-1));
+  std::fill(fValues,fValues+fNValues,value);
+  UpdateEventOffset();
+};
+void GFWWeightTable::UpdateEventOffset() {
+  fEventOffset=0;
+  for(auto &axis: fAxes) if(axis.Type==kEvent) fEventOffset+=axis.EventBin*axis.Stride;
+};
+int GFWWeightTable::AddAxis(string axisName, int type, int nBins, double min, double max) {
+  if(nBins<1 || type<kPhi || type>kEvent) { printf("Weights: axis %s must have a valid type and at least one bin!\n",axisName.c_str()); return -1; };
+  if(type!=kBin && min>=max) { printf("Weights: min. of axis %s cannot be more than max.!\n",axisName.c_str()); return -1; };
+  Axis lAxis;
+  lAxis.Name = axisName;
+  lAxis.Type = type;
+  lAxis.NBins = nBins;
+  lAxis.Min = (type==kBin)?0:min;
+  lAxis.Max = (type==kBin)?nBins:max;
+  lAxis.InvWidth = nBins/(lAxis.Max-lAxis.Min);
+  lAxis.Stride = 0;
+  lAxis.EventBin = 0;
+  fAxes.push_back(lAxis);
+  Allocate(1);
+  return (int)fAxes.size()-1;
+};
+void GFWWeightTable::SetValue(const vector<int> &bins, double value) {
+  if(bins.size()!=fAxes.size()) return;
+  long lInd=0;
+  for(int i=0;i<(int)fAxes.size();i++) {
+    if(bins[i]<0 || bins[i]>=fAxes[i].NBins) return;
+    lInd+=bins[i]*fAxes[i].Stride;
+  };
+  fValues[lInd] = value;
+};
+double GFWWeightTable::GetValue(const vector<int> &bins) const {
+  if(bins.size()!=fAxes.size()) return 0;
+  long lInd=0;
+  for(int i=0;i<(int)fAxes.size();i++) {
+    if(bins[i]<0 || bins[i]>=fAxes[i].NBins) return 0;
+    lInd+=bins[i]*fAxes[i].Stride;
+  };
+  return fValues[lInd];
+};
+void GFWWeightTable::SetEventValue(string axisName, double value) {
+  for(auto &axis: fAxes) if(axis.Type==kEvent && axis.Name==axisName) axis.EventBin = FindBin(axis,value);
+  UpdateEventOffset();
+};
+long GFWWeightTable::GetIndex(double phi, double eta, int bin) const {
+  long retInd = fEventOffset;
+  for(const Axis &axis: fAxes) {
+    if(axis.Type==kPhi) retInd+=FindBin(axis,phi)*axis.Stride;
+    else if(axis.Type==kEta) retInd+=FindBin(axis,eta)*axis.Stride;
+    else if(axis.Type==kBin) retInd+=((bin<0)?0:((bin<axis.NBins)?bin:axis.NBins-1))*axis.Stride;
+  };
+  return retInd;
+};
+void GFWWeightTable::Lookup(int nTracks, const double *phi, const double *eta, const int *bin, const double *weight, double *out) const {
+  long lIdx[kLookupBlock];
+  for(int lStart=0;lStart<nTracks;lStart+=kLookupBlock) {
+    int lN = nTracks-lStart;
+    if(lN>kLookupBlock) lN=kLookupBlock;
+    for(int i=0;i<lN;i++) lIdx[i]=fEventOffset;
+    for(const Axis &axis: fAxes) {
+      if(axis.Type==kPhi) { const double *lPhi = phi+lStart; for(int i=0;i<lN;i++) lIdx[i]+=FindBin(axis,lPhi[i])*axis.Stride; }
+      else if(axis.Type==kEta) { const double *lEta = eta+lStart; for(int i=0;i<lN;i++) lIdx[i]+=FindBin(axis,lEta[i])*axis.Stride; }
+      else if(axis.Type==kBin) {
+        const int *lBin = bin+lStart;
+        const int lMax = axis.NBins-1;
+        for(int i=0;i<lN;i++) lIdx[i]+=std::min(std::max(lBin[i],0),lMax)*axis.Stride;
+      };
+    };
+    for(int i=0;i<lN;i++) out[lStart+i] = weight[lStart+i]*fValues[lIdx[i]];
+  };
+};
+bool GFWWeightTable::Load(string fileName) {
+  FILE *lFile = fopen(fileName.c_str(),"rb");
+  if(!lFile) { printf("Could not open %s!\n",fileName.c_str()); return false; };
+  char lMagic[8];
+  uint32_t lVersion=0, nAxes=0;
+  bool isOk = fread(lMagic,8,1,lFile)==1 && !memcmp(lMagic,kWeightsMagic,8) && fread(&lVersion,sizeof(lVersion),1,lFile)==1 && fread(&nAxes,sizeof(nAxes),1,lFile)==1;
+  if(!isOk || lVersion>kWeightsVersion) { printf("%s is not a GFW weights file, or has a newer version!\n",fileName.c_str()); fclose(lFile); return false; };
+  //The table is only replaced once the whole file has been read. Its size is checked against that of the file before anything is allocated
+  long lFileSize = (fseek(lFile,0,SEEK_END)==0)?ftell(lFile):0;
+  fseek(lFile,16,SEEK_SET);
+  double lTableSize = sizeof(double);
+  GFWWeightTable lNew;
+  for(uint32_t i=0;i<nAxes && isOk;i++) {
+    uint32_t lLength=0;
+    int32_t lType=0, nBins=0;
+    double lMin=0, lMax=0;
+    isOk = fread(&lLength,sizeof(lLength),1,lFile)==1 && lLength<(1u<<16);
+    string lName(isOk?lLength:0,' ');
+    isOk = isOk && (!lLength || fread(&lName[0],1,lLength,lFile)==lLength);
+    isOk = isOk && fread(&lType,sizeof(lType),1,lFile)==1 && fread(&nBins,sizeof(nBins),1,lFile)==1 && fread(&lMin,sizeof(lMin),1,lFile)==1 && fread(&lMax,sizeof(lMax),1,lFile)==1;
+    lTableSize*=nBins;
+    isOk = isOk && lTableSize<=lFileSize && lNew.AddAxis(lName,lType,nBins,lMin,lMax)>-1;
+  };
+  uint64_t nValues=0;
+  isOk = isOk && fread(&nValues,sizeof(nValues),1,lFile)==1 && nValues==(uint64_t)lNew.fNValues && fread(lNew.fValues,sizeof(double),nValues,lFile)==nValues;
+  fclose(lFile);
+  if(!isOk) { printf("Corrupted weights file %s!\n",fileName.c_str()); return false; };
+  swap(lNew);
+  return true;
+};
+bool GFWWeightTable::Save(string fileName) const {
+  FILE *lFile = fopen(fileName.c_str(),"wb");
+  if(!lFile) { printf("Could not open %s for writing!\n",fileName.c_str()); return false; };
+  uint32_t nAxes = (uint32_t)fAxes.size();
+  fwrite(kWeightsMagic,8,1,lFile);
+  fwrite(&kWeightsVersion,sizeof(kWeightsVersion),1,lFile);
+  fwrite(&nAxes,sizeof(nAxes),1,lFile);
+  for(const Axis &axis: fAxes) {
+    uint32_t lLength = (uint32_t)axis.Name.size();
+    int32_t lType = axis.Type, nBins = axis.NBins;
+    fwrite(&lLength,sizeof(lLength),1,lFile);
+    fwrite(axis.Name.data(),1,lLength,lFile);
+    fwrite(&lType,sizeof(lType),1,lFile);
+    fwrite(&nBins,sizeof(nBins),1,lFile);
+    fwrite(&axis.Min,sizeof(double),1,lFile);
+    fwrite(&axis.Max,sizeof(double),1,lFile);
+  };
+  uint64_t nValues = fNValues;
+  fwrite(&nValues,sizeof(nValues),1,lFile);
+  bool isOk = fwrite(fValues,sizeof(double),fNValues,lFile)==(size_t)fNValues;
+  return !fclose(lFile) && isOk;
+};
@@ -0,0 +1,60 @@
+/*
+Author: Vytautas Vislavicius
+Extention of Generic Flow (https://arxiv.org/abs/1312.3572 by A. Bilandzic et al.)
+A part of <GFW.cxx/h>
+Table of track weights (e.g. NUA and NUE corrections) in any number of uniformly binned axes, looked up by GFW while filling (see GFW::UseWeights).
+Axes are either track variables (phi, eta, or the bin index passed to GFW::Fill, e.g. pT bin) or event variables (e.g. vz or centrality) that are set once per event.
+Values are stored as a single flat, cache-aligned block, with the first axis running fastest. Values outside of the range of an axis are taken from its first/last bin.
+Tables can be saved to and loaded from a simple binary file:
+  Header (16 bytes): "GFWWGHTS", uint32 version, uint32 number of axes
+  Axis: uint32 length of the name, name, int32 type (Axis_t), int32 number of bins, double min, double max
+  Values: uint64 number of values, followed by the values (double), first axis running fastest. Numbers are stored in native byte order.
+If used, modified, or distributed, please aknowledge the author of this code.
+*/
+#ifndef GFWWEIGHTTABLE__H
+#define GFWWEIGHTTABLE__H
+#include <vector>
+#include <string>
+using std::vector;
+using std::string;
+class GFWWeightTable {
+ public:
+  enum Axis_t {kPhi=0, kEta=1, kBin=2, kEvent=3}; //For kBin, min and max are not used and bins are the bin indices 0..nBins-1
+  GFWWeightTable();
+  ~GFWWeightTable();
+  GFWWeightTable(const GFWWeightTable &other);
+  GFWWeightTable &operator=(GFWWeightTable other);
+  void swap(GFWWeightTable &other) noexcept;
+  int AddAxis(string axisName, int type, int nBins, double min=0, double max=1); //Returns index of the axis. Values are reset to 1
+  int GetNAxes() const { return (int)fAxes.size(); };
+  long GetNValues() const { return fNValues; };
+  double *GetValues() { return fValues; }; //All the values, first axis running fastest
+  void SetValue(const vector<int> &bins, double value); //Bins on each of the axes, in the order they were added
+  double GetValue(const vector<int> &bins) const;
+  void SetEventValue(string axisName, double value); //Value of an event variable, e.g. vz, for the following lookups. Unknown names are ignored
+  double Get(double phi, double eta, int bin) const { return fValues[GetIndex(phi,eta,bin)]; };
+  //out[i] = weight[i] times the table value for each track. Indices are calculated axis by axis over blocks of tracks, so that the loops vectorize
+  void Lookup(int nTracks, const double *phi, const double *eta, const int *bin, const double *weight, double *out) const;
+  bool Load(string fileName);
+  bool Save(string fileName) const;
+ protected:
+  static const size_t kAlignment = 64;
+  static const int kLookupBlock = 256; //Number of tracks per block in Lookup
+  struct Axis {
+    string Name;
+    int Type, NBins;
+    double Min, Max, InvWidth;
+    long Stride;
+    int EventBin; //Current bin of event variables
+  };
+  vector<Axis> fAxes;
+  void *fBlock; //Raw (unaligned) allocation
+  double *fValues; //Aligned start of values
+  long fNValues;
+  long fEventOffset; //Offset of the current bins of event variables
+  void Allocate(double value);
+  void UpdateEventOffset();
+  static int FindBin(const Axis &axis, double val) { if(!(val>axis.Min)) return 0; double lBin = (val-axis.Min)*axis.InvWidth; return (lBin<axis.NBins)?(int)lBin:axis.NBins-1; };
+  long GetIndex(double phi, double eta, int bin) const;
+};
+#endif
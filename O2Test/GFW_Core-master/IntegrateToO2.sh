@@ -61,8 +61,21 @@ cp GFW*.cxx ${tarDir}/PWGCF/GenericFramework/
 cp GFW*.h ${tarDir}/PWGCF/GenericFramework/
 AddToCMakeFile GFWPowerArray.cxx GFW.cxx ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
 AddToCMakeFile GFWPowerArray.h GFW.h ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWPlan.cxx GFW.cxx ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWPlan.h GFW.h ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWSimd.h GFW.h ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWKernels.cxx GFW.cxx ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWKernels.h GFW.h ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWPartitions.cxx GFW.cxx ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWPartitions.h GFW.h ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWInstrument.cxx GFW.cxx ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWInstrument.h GFW.h ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWThreadPool.cxx GFW.cxx ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWThreadPool.h GFW.h ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWWeightTable.cxx GFW.cxx ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
+AddToCMakeFile GFWWeightTable.h GFW.h ${tarDir}/PWGCF/GenericFramework/CMakeLists.txt
 FixTask ${tarDir}/PWGCF/Tasks/flowGenericFramework.cxx
 FixTask ${tarDir}/PWGDQ/Core/VarManager.h
 FixTask ${tarDir}/PWGDQ/Tasks/dqFlow.cxx
 echo "All done! To stage all changes for commit, please run:"
-echo "cd ${tarDir} && git add PWGCF/GenericFramework/GFWPowerArray.cxx PWGCF/GenericFramework/GFWPowerArray.h PWGCF/GenericFramework/GFW.cxx PWGCF/GenericFramework/GFW.h PWGCF/GenericFramework/GFWCumulant.cxx PWGCF/GenericFramework/GFWCumulant.h PWGCF/GenericFramework/CMakeLists.txt PWGCF/Tasks/flowGenericFramework.cxx PWGDQ/Core/VarManager.h PWGDQ/Tasks/dqFlow.cxx"
+echo "cd ${tarDir} && git add PWGCF/GenericFramework/GFWPowerArray.cxx PWGCF/GenericFramework/GFWPowerArray.h PWGCF/GenericFramework/GFWPlan.cxx PWGCF/GenericFramework/GFWPlan.h PWGCF/GenericFramework/GFWSimd.h PWGCF/GenericFramework/GFWKernels.cxx PWGCF/GenericFramework/GFWKernels.h PWGCF/GenericFramework/GFWPartitions.cxx PWGCF/GenericFramework/GFWPartitions.h PWGCF/GenericFramework/GFWInstrument.cxx PWGCF/GenericFramework/GFWInstrument.h PWGCF/GenericFramework/GFWThreadPool.cxx PWGCF/GenericFramework/GFWThreadPool.h PWGCF/GenericFramework/GFWWeightTable.cxx PWGCF/GenericFramework/GFWWeightTable.h PWGCF/GenericFramework/GFW.cxx PWGCF/GenericFramework/GFW.h PWGCF/GenericFramework/GFWCumulant.cxx PWGCF/GenericFramework/GFWCumulant.h PWGCF/GenericFramework/CMakeLists.txt PWGCF/Tasks/flowGenericFramework.cxx PWGDQ/Core/VarManager.h PWGDQ/Tasks/dqFlow.cxx"